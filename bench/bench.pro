@@ -0,0 +1,13 @@
+BUILD_FLAGS = 3rd_ftdi
+
+TARGET = qticsneobench
+TEMPLATE = app
+CONFIG += console release
+CONFIG -= app_bundle
+
+MOC_DIR = objects
+OBJECTS_DIR = objects
+
+include(../icsneo.pri)
+
+SOURCES += main.cpp
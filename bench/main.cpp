@@ -0,0 +1,429 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+/**
+ * Benchmarks of plugin hot paths. Backend sources are compiled in, so private parts are
+ * measured directly - simulated and replay interfaces and mocked discovery cache stand
+ * in for hardware.
+ * Results are written as JSON to compare runs across plugin and libicsneo updates.
+ */
+
+#include "icsneocanbackend.h"
+#include "icsneocanbackend_p.h"
+#include "icsneocapturewriter.h"
+#include "icsneotimesync.h"
+#include "icsneovirtualdevice.h"
+#include "include/qticsneo_keys.h"
+
+#include <QtCore/qcommandlineparser.h>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qeventloop.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qjsonarray.h>
+#include <QtCore/qjsondocument.h>
+#include <QtCore/qjsonobject.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+Q_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_ICSNEOCAN, "qt.canbus.plugins.icsneo")
+QT_END_NAMESPACE
+
+namespace {
+
+// Keeps compiler from removing benchmarked calls
+volatile quint64 g_sink = 0;
+
+/*-----------------------------------------------------------------------------------------
+                                 M I C R O   B E N C H M A R K S
+-----------------------------------------------------------------------------------------*/
+// Runs body in several batches - median of batches is reported as it is not affected by
+// occasional preemption
+template <typename Body>
+QJsonObject measure(const QString &name, int iterations, Body body)
+{
+    static const int Batches = 7;
+    std::vector<double> times;
+
+    for (int batch = 0; batch < Batches; batch++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+            body();
+        times.push_back(double(timer.nsecsElapsed()) / iterations);
+    }
+    std::sort(times.begin(), times.end());
+
+    return QJsonObject {
+        { QStringLiteral("name"), name },
+        { QStringLiteral("iterations"), iterations * Batches },
+        { QStringLiteral("ns_per_op"), times[Batches / 2] },
+        { QStringLiteral("ns_per_op_min"), times.front() },
+    };
+}
+
+icsneo::CANMessage createCanMessage(bool fd)
+{
+    icsneo::CANMessage message;
+    message.network = icsneo::Network(icsneo::Network::NetID::HSCAN);
+    message.arbid = 0x123;
+    message.isCANFD = fd;
+    message.baudrateSwitch = fd;
+    message.data.assign(fd ? 64 : 8, 0x55);
+    message.timestamp = 1000000000;
+    return message;
+}
+
+QCanBusFrame createFrame(bool fd)
+{
+    QCanBusFrame frame(0x123, QByteArray(fd ? 64 : 8, 0x55));
+    frame.setFlexibleDataRateFormat(fd);
+    frame.setBitrateSwitch(fd);
+    return frame;
+}
+
+// Receive conversion as it was before payload was copied at once - baseline for interpretFrame
+QCanBusFrame interpretFrameBaseline(const icsneo::CANMessage &msg)
+{
+    QByteArray data;
+    for (auto b : msg.data)
+        data.append(b);
+
+    QCanBusFrame frame(msg.arbid, data);
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(msg.timestamp));
+    frame.setExtendedFrameFormat(msg.isExtended);
+    frame.setFlexibleDataRateFormat(msg.isCANFD);
+    frame.setErrorStateIndicator(msg.errorStateIndicator);
+    if (msg.error)
+        frame.setFrameType(QCanBusFrame::ErrorFrame);
+    else if (msg.isRemote)
+        frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    else
+        frame.setFrameType(QCanBusFrame::DataFrame);
+    return frame;
+}
+
+QJsonArray microBenchmarks(int iterations)
+{
+    QJsonArray results;
+
+    // Private part is used standalone - it is not bound to any device
+    IcsNeoCanBackend backend(QStringLiteral("sim0.0"));
+    IcsNeoCanBackendPrivate d(&backend);
+    d.setupChannel(QStringLiteral("sim0.0"));
+
+    const icsneo::CANMessage classicMessage = createCanMessage(false);
+    const icsneo::CANMessage fdMessage = createCanMessage(true);
+    results.append(measure(QStringLiteral("interpretFrame/baseline/classic8"), iterations, [&]() {
+        g_sink += quint64(interpretFrameBaseline(classicMessage).payload().size());
+    }));
+    results.append(measure(QStringLiteral("interpretFrame/baseline/fd64"), iterations, [&]() {
+        g_sink += quint64(interpretFrameBaseline(fdMessage).payload().size());
+    }));
+    results.append(measure(QStringLiteral("interpretFrame/classic8"), iterations, [&]() {
+        g_sink += quint64(d.interpretFrame(classicMessage).payload().size());
+    }));
+    results.append(measure(QStringLiteral("interpretFrame/fd64"), iterations, [&]() {
+        g_sink += quint64(d.interpretFrame(fdMessage).payload().size());
+    }));
+
+    const QCanBusFrame classicFrame = createFrame(false);
+    const QCanBusFrame fdFrame = createFrame(true);
+    results.append(measure(QStringLiteral("createMessage/classic8"), iterations, [&]() {
+        g_sink += d.createMessage(classicFrame)->data.size();
+    }));
+    results.append(measure(QStringLiteral("createMessage/fd64"), iterations, [&]() {
+        g_sink += d.createMessage(fdFrame)->data.size();
+    }));
+
+    // Hardware names need device to resolve networks - only their name parsing is measured
+    const QStringList names = { QStringLiteral("can0.1"), QStringLiteral("can0.0,1,2,3"), QStringLiteral("can0.*") };
+    const QStringList nameCases = { QStringLiteral("can"), QStringLiteral("aggregate"), QStringLiteral("wildcard") };
+    for (int i = 0; i < names.size(); i++)
+    {
+        const QString &name = names[i];
+        results.append(measure(QStringLiteral("parseInterfaceName/%1").arg(nameCases[i]), iterations, [&]() {
+            QString kind;
+            quint8 deviceNumber = 0;
+            QVector<quint8> channels;
+            g_sink += IcsNeoCanBackendPrivate::parseInterfaceName(name, &kind, &deviceNumber, &channels);
+            g_sink += quint64(channels.size());
+        }));
+    }
+
+    const QString simName = QStringLiteral("sim12.3");
+    const QString replayName = QStringLiteral("replay0.1");
+    results.append(measure(QStringLiteral("setupChannel/sim"), iterations, [&]() {
+        g_sink += d.setupChannel(simName);
+    }));
+    results.append(measure(QStringLiteral("setupChannel/replay"), iterations, [&]() {
+        g_sink += d.setupChannel(replayName);
+    }));
+
+    // Discovery is fed with mocked devices as if probed by refreshDevices() - merge into cache,
+    // listing served from cache and device lookup done by backend constructor are measured.
+    // Mocked devices have no libicsneo handle.
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false")); // createDeviceInfo() logs every channel
+    QVector<IcsNeoCanBackendPrivate::DiscoveredDevice> mocked;
+    for (uint number = 0; number < 4; number++)
+        mocked.append({ QStringLiteral("BN%1").arg(number), QStringLiteral("mocked device"), 8, nullptr });
+    results.append(measure(QStringLiteral("discovery/update"), qMax(1, iterations / 100), [&]() {
+        IcsNeoCanBackendPrivate::updateDiscovered(mocked);
+    }));
+    results.append(measure(QStringLiteral("interfaces/cached"), iterations, [&]() {
+        g_sink += quint64(IcsNeoCanBackend::interfaces().size());
+    }));
+    const QString channelName = QStringLiteral("can3.7");
+    const QString wildcardName = QStringLiteral("can2.*");
+    results.append(measure(QStringLiteral("deviceFor/can"), iterations, [&]() {
+        g_sink += quint64(!IcsNeoCanBackendPrivate::deviceFor(channelName));
+    }));
+    results.append(measure(QStringLiteral("deviceFor/wildcard"), iterations, [&]() {
+        g_sink += quint64(!IcsNeoCanBackendPrivate::deviceFor(wildcardName));
+    }));
+
+    results.append(measure(QStringLiteral("frameDuration/fd64"), iterations, [&]() {
+        g_sink += quint64(IcsNeoLoopbackDevice::frameDuration(fdMessage, 1000000, 5000000));
+    }));
+    return results;
+}
+
+/*-----------------------------------------------------------------------------------------
+                               E N D   T O   E N D   S C E N A R I O S
+-----------------------------------------------------------------------------------------*/
+struct Scenario
+{
+    QString name;
+    int channels;
+    bool fd;
+    int bitRate;        // 0 - simulated bus without timing
+    int dataBitRate;
+    int window;         // frames in flight per channel - 1 measures round trip
+    int batchSize;      // ParameterReceiveBatchSizeKey, 0 - default
+};
+
+qint64 percentile(const std::vector<qint64> &sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, size_t(fraction * double(sorted.size())))];
+}
+
+// Frames carry their transmit time in first 8 bytes of payload, so latency is measured from
+// writeFrame() to reception by application
+QJsonObject runScenario(const Scenario &scenario, int durationMs)
+{
+    std::vector<std::unique_ptr<IcsNeoCanBackend>> backends;
+    std::vector<qint64> latencies;
+    latencies.reserve(1 << 20);
+    quint64 received = 0;
+    bool running = true;
+    QCanBusFrame frame = createFrame(scenario.fd);
+    QString error;
+
+    auto send = [&](IcsNeoCanBackend *backend, int count) {
+        for (int i = 0; i < count; i++)
+        {
+            QByteArray payload = frame.payload();
+            qToLittleEndian<qint64>(IcsNeoClockCorrelator::hostNow(), payload.data());
+            frame.setPayload(payload);
+            backend->writeFrame(frame);
+        }
+    };
+
+    for (int channel = 0; channel < scenario.channels; channel++)
+    {
+        backends.emplace_back(new IcsNeoCanBackend(QStringLiteral("sim0.%1").arg(channel)));
+        IcsNeoCanBackend *backend = backends.back().get();
+        backend->setConfigurationParameter(QCanBusDevice::CanFdKey, scenario.fd);
+        backend->setConfigurationParameter(QCanBusDevice::BitRateKey, scenario.bitRate);
+        backend->setConfigurationParameter(QCanBusDevice::DataBitRateKey, scenario.dataBitRate);
+        if (scenario.batchSize > 0)
+            backend->setConfigurationParameter(ParameterReceiveBatchSizeKey, scenario.batchSize);
+
+        QObject::connect(backend, &QCanBusDevice::framesReceived, backend, [&, backend]() {
+            const QVector<QCanBusFrame> frames = backend->readAllFrames();
+            const qint64 now = IcsNeoClockCorrelator::hostNow();
+            for (const QCanBusFrame &echo : frames)
+                latencies.push_back(now - qFromLittleEndian<qint64>(echo.payload().constData()));
+            received += quint64(frames.size());
+            if (running)
+                send(backend, frames.size());
+        });
+
+        if (!backend->connectDevice())
+            error = backend->errorString();
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (auto &backend : backends)
+        send(backend.get(), scenario.window);
+
+    QEventLoop loop;
+    QTimer::singleShot(durationMs, &loop, [&]() { running = false; loop.quit(); });
+    loop.exec();
+    const double seconds = double(elapsed.nsecsElapsed()) / 1e9;
+
+    for (auto &backend : backends)
+        backend->disconnectDevice();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    // Upper bound given by emulated bus
+    icsneo::CANMessage message = createCanMessage(scenario.fd);
+    const qint64 busFrameTime = IcsNeoLoopbackDevice::frameDuration(message, scenario.bitRate, scenario.dataBitRate);
+
+    QJsonObject result {
+        { QStringLiteral("name"), scenario.name },
+        { QStringLiteral("channels"), scenario.channels },
+        { QStringLiteral("fd"), scenario.fd },
+        { QStringLiteral("bitrate"), scenario.bitRate },
+        { QStringLiteral("data_bitrate"), scenario.dataBitRate },
+        { QStringLiteral("window"), scenario.window },
+        { QStringLiteral("frames"), double(received) },
+        { QStringLiteral("seconds"), seconds },
+        { QStringLiteral("frames_per_second"), double(received) / seconds },
+        { QStringLiteral("bus_frames_per_second"), busFrameTime ? 1e9 / double(busFrameTime) * scenario.channels : 0.0 },
+        { QStringLiteral("latency_ns"), QJsonObject {
+              { QStringLiteral("p50"), double(percentile(latencies, 0.5)) },
+              { QStringLiteral("p99"), double(percentile(latencies, 0.99)) },
+              { QStringLiteral("p999"), double(percentile(latencies, 0.999)) },
+              { QStringLiteral("max"), double(latencies.empty() ? 0 : latencies.back()) } } },
+    };
+    if (!error.isEmpty())
+        result.insert(QStringLiteral("error"), error);
+    return result;
+}
+
+QJsonArray endToEndBenchmarks(int durationMs)
+{
+    const std::vector<Scenario> scenarios {
+        { QStringLiteral("roundtrip/nobus"),            1, false, 0,       0,       1,  0 },
+        { QStringLiteral("roundtrip/nobus/nobatch"),    1, false, 0,       0,       1,  1 },
+        { QStringLiteral("roundtrip/classic500k"),      1, false, 500000,  0,       1,  1 },
+        { QStringLiteral("saturated/classic1M/1ch"),    1, false, 1000000, 0,       32, 0 },
+        { QStringLiteral("saturated/classic1M/4ch"),    4, false, 1000000, 0,       32, 0 },
+        { QStringLiteral("saturated/classic1M/8ch"),    8, false, 1000000, 0,       32, 0 },
+        { QStringLiteral("saturated/fd1M5M/1ch"),       1, true,  1000000, 5000000, 32, 0 },
+        { QStringLiteral("saturated/fd1M5M/4ch"),       4, true,  1000000, 5000000, 32, 0 },
+        { QStringLiteral("saturated/fd1M5M/8ch"),       8, true,  1000000, 5000000, 32, 0 },
+    };
+
+    QJsonArray results;
+    for (const Scenario &scenario : scenarios)
+        results.append(runScenario(scenario, durationMs));
+    return results;
+}
+
+/*-----------------------------------------------------------------------------------------
+                                        C A P T U R E
+-----------------------------------------------------------------------------------------*/
+// Capture writer fed by single thread as fast as it accepts frames - frames it had to drop show
+// where disk stops keeping up. Compared with 8 saturated CAN-FD channels at 1 / 8 Mbit/s.
+QJsonObject captureBenchmark(int durationMs)
+{
+    const QString fileName = QDir::temp().filePath(QStringLiteral("qticsneobench-%1.pcapng")
+                                                   .arg(QCoreApplication::applicationPid()));
+    const icsneo::CANMessage message = createCanMessage(true);
+    const qint64 busFrameTime = IcsNeoLoopbackDevice::frameDuration(message, 1000000, 8000000);
+
+    QJsonObject result {
+        { QStringLiteral("name"), QStringLiteral("capture/fd64") },
+        { QStringLiteral("required_frames_per_second"), 8 * 1e9 / double(busFrameTime) },
+    };
+
+    IcsNeoCaptureWriter writer(fileName, { QStringLiteral("bench") });
+    QString error;
+    if (!writer.open(&error))
+    {
+        result.insert(QStringLiteral("error"), error);
+        return result;
+    }
+
+    quint64 offered = 0;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (elapsed.elapsed() < durationMs)
+    {
+        for (int i = 0; i < 1000; i++, offered++)
+            writer.write(0, offered * 1000, message.arbid, message.data.data(), int(message.data.size()),
+                         true, IcsNeoCaptureWriter::BitrateSwitchFlag);
+    }
+    writer.close();     // pending blocks are on disk when time is taken
+    const double seconds = double(elapsed.nsecsElapsed()) / 1e9;
+
+    const quint64 stored = offered - writer.droppedFrames();
+    result.insert(QStringLiteral("frames"), double(stored));
+    result.insert(QStringLiteral("dropped"), double(writer.droppedFrames()));
+    result.insert(QStringLiteral("seconds"), seconds);
+    result.insert(QStringLiteral("frames_per_second"), double(stored) / seconds);
+    result.insert(QStringLiteral("megabytes_per_second"), double(QFileInfo(fileName).size()) / seconds / 1e6);
+    if (writer.hasFailed())
+        result.insert(QStringLiteral("error"), writer.errorString());
+
+    QFile::remove(fileName);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Benchmarks of qticsneo CAN bus plugin"));
+    parser.addHelpOption();
+    const QCommandLineOption outputOption({ QStringLiteral("o"), QStringLiteral("output") },
+                                          QStringLiteral("Write JSON results into <file> instead of stdout."),
+                                          QStringLiteral("file"));
+    const QCommandLineOption iterationsOption({ QStringLiteral("i"), QStringLiteral("iterations") },
+                                              QStringLiteral("Iterations of micro benchmark batch."),
+                                              QStringLiteral("count"), QStringLiteral("100000"));
+    const QCommandLineOption durationOption({ QStringLiteral("d"), QStringLiteral("duration") },
+                                            QStringLiteral("Duration of end to end scenario in ms."),
+                                            QStringLiteral("ms"), QStringLiteral("2000"));
+    parser.addOptions({ outputOption, iterationsOption, durationOption });
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const int durationMs = qMax(1, parser.value(durationOption).toInt());
+
+    const QJsonObject report {
+        { QStringLiteral("qt"), QString::fromLatin1(qVersion()) },
+        { QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { QStringLiteral("micro"), microBenchmarks(iterations) },
+        { QStringLiteral("end_to_end"), endToEndBenchmarks(durationMs) },
+        { QStringLiteral("capture"), captureBenchmark(durationMs) },
+    };
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (!parser.isSet(outputOption))
+    {
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(json);
+        return 0;
+    }
+
+    QFile output(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size())
+    {
+        qCritical("Cannot write %s", qPrintable(output.fileName()));
+        return 1;
+    }
+    return 0;
+}
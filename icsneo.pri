@@ -0,0 +1,120 @@
+# Backend sources and libicsneo shared by plugin and bench
+
+QT = core serialbus
+
+INCLUDEPATH += $$PWD/libicsneo/include \
+               $$PWD/generated/ \
+               $$PWD
+
+# Controller error frames need error counter messages - older libicsneo is built without them
+exists($$PWD/libicsneo/include/icsneo/communication/message/canerrorcountmessage.h): DEFINES += ICSNEO_HAS_ERROR_COUNT_MESSAGE
+
+ICSNEO_SOURCES +=   $$PWD/libicsneo/api/icsneocpp/event.cpp \
+                    $$PWD/libicsneo/api/icsneocpp/eventmanager.cpp \
+                    $$PWD/libicsneo/api/icsneocpp/icsneocpp.cpp \
+                    $$PWD/libicsneo/api/icsneocpp/version.cpp \
+                    $$PWD/libicsneo/communication/packet/canpacket.cpp \
+                    $$PWD/libicsneo/communication/packet/ethernetpacket.cpp \
+                    $$PWD/libicsneo/communication/packet/flexraypacket.cpp \
+                    $$PWD/libicsneo/communication/packet/iso9141packet.cpp \
+                    $$PWD/libicsneo/communication/packet/versionpacket.cpp \
+                    $$PWD/libicsneo/communication/decoder.cpp \
+                    $$PWD/libicsneo/communication/encoder.cpp \
+                    $$PWD/libicsneo/communication/ethernetpacketizer.cpp \
+                    $$PWD/libicsneo/communication/packetizer.cpp \
+                    $$PWD/libicsneo/communication/multichannelcommunication.cpp \
+                    $$PWD/libicsneo/communication/communication.cpp \
+                    $$PWD/libicsneo/communication/driver.cpp \
+                    $$PWD/libicsneo/communication/message/flexray/control/flexraycontrolmessage.cpp \
+                    $$PWD/libicsneo/communication/message/neomessage.cpp \
+                    $$PWD/libicsneo/device/extensions/flexray/controller.cpp \
+                    $$PWD/libicsneo/device/extensions/flexray/extension.cpp \
+                    $$PWD/libicsneo/device/idevicesettings.cpp \
+                    $$PWD/libicsneo/device/devicefinder.cpp \
+                    $$PWD/libicsneo/device/device.cpp
+
+unix{
+
+     QMAKE_CXXFLAGS += -Wno-sign-compare -Wno-unused-parameter -Wno-switch -Wno-missing-field-initializers -Wno-implicit-fallthrough  #to get rid of annnoying icsneo warrnings
+     QMAKE_CFLAGS = $$QMAKE_CXXFLAGS
+
+     CONFIG    += link_pkgconfig object_parallel_to_source
+
+     PKGCONFIG += libpcap
+
+     #LIBS+=             $$PWD/libicsneo/build/third-party/libftdi/src/libftdi1.a
+
+     ICSNEO_SOURCES +=   $$PWD/libicsneo/platform/posix/ftdi.cpp \
+                         $$PWD/libicsneo/platform/posix/pcap.cpp \
+                         $$PWD/libicsneo/platform/posix/cdcacm.cpp \
+                         $$PWD/libicsneo/platform/posix/linux/cdcacmlinux.cpp
+
+
+    contains(BUILD_FLAGS, 3rd_ftdi){
+
+        INCLUDEPATH +=     $$PWD/libicsneo/third-party/libftdi/src
+                           $$PWD/libicsneo/third-party/libftdi/ftdipp
+
+        ICSNEO_SOURCES += $$PWD/libicsneo/third-party/libftdi/ftdipp/ftdi.cpp \
+                          $$PWD/libicsneo/third-party/libftdi/src/ftdi_stream.c \
+                          $$PWD/libicsneo/third-party/libftdi/src/ftdi.c
+    }
+
+    contains(BUILD_FLAGS, system_ftdi){
+       PKGCONFIG += libftdi1
+    }
+    else
+       PKGCONFIG += libusb-1.0
+
+}
+
+win32-gcc{
+    QMAKE_CXXFLAGS += -std=c++17 -Wno-sign-compare -Wno-unused-parameter -Wno-switch -Wno-missing-field-initializers -Wimplicit-fallthrough=0  #to get rid of annnoying icsneo warrnings
+    QMAKE_CFLAGS = $$QMAKE_CXXFLAGS
+    CONFIG+= object_parallel_to_source # to separate multiple ftdi.o files 
+}
+
+win32-msvc*{
+   QMAKE_CXXFLAGS+=  /Zc:strictStrings-  /std:c++17 #thid-party/wincap/pcap.cpp generated C2664 error
+}
+
+win32{
+
+    QMAKE_CXXFLAGS +=   -DWPCAP -DHAVE_REMOTE -DWIN32_LEAN_AND_MEAN   # to force including Win32-Extensions from pcap.h in third-party/winpcap/inlclude
+    INCLUDEPATH    +=   $$PWD/libicsneo/third-party/optional-lite/include \
+                        $$PWD/libicsneo/third-party/winpcap/include
+
+    ICSNEO_SOURCES +=   $$PWD/libicsneo/platform/windows/internal/pcapdll.cpp \
+                        $$PWD/libicsneo/platform/windows/pcap.cpp \
+                        $$PWD/libicsneo/platform/windows/vcp.cpp \
+                        $$PWD/libicsneo/platform/windows/registry.cpp
+
+    LIBS+= -liphlpapi  -lAdvapi32
+}
+
+
+HEADERS += $$PWD/icsneocanbackend.h \
+           $$PWD/icsneocanbackend_p.h \
+           $$PWD/icsneocapturewriter.h \
+           $$PWD/icsneoframefilter.h \
+           $$PWD/icsneomergebackend.h \
+           $$PWD/icsneopayloadpool.h \
+           $$PWD/icsneoscheduler.h \
+           $$PWD/icsneospscring.h \
+           $$PWD/icsneostatistics.h \
+           $$PWD/icsneosupervisor.h \
+           $$PWD/icsneotimesync.h \
+           $$PWD/icsneotransmitworker.h \
+           $$PWD/icsneovirtualdevice.h
+
+SOURCES += $$PWD/icsneocanbackend.cpp \
+            $$PWD/icsneocapturewriter.cpp \
+            $$PWD/icsneoframefilter.cpp \
+            $$PWD/icsneomergebackend.cpp \
+            $$PWD/icsneoscheduler.cpp \
+            $$PWD/icsneostatistics.cpp \
+            $$PWD/icsneosupervisor.cpp \
+            $$PWD/icsneotimesync.cpp \
+            $$PWD/icsneotransmitworker.cpp \
+            $$PWD/icsneovirtualdevice.cpp \
+            $$ICSNEO_SOURCES
@@ -3,6 +3,7 @@
 
 #include <QCanBusFactoryV2>
 #include "icsneocanbackend.h"
+#include "icsneomergebackend.h"
 
 #include <QtCore/qloggingcategory.h>
 
@@ -26,6 +27,9 @@ public:
     QCanBusDevice *createDevice(const QString &interfaceName, QString *errorMessage) const override
     {
         Q_UNUSED(errorMessage);
+        // merge:A;B;... delivers frames of source interfaces as single time ordered stream
+        if (IcsNeoMergeBackend::isMergeInterface(interfaceName))
+            return new IcsNeoMergeBackend(interfaceName);
         auto device = new IcsNeoCanBackend(interfaceName);
         return device;
     }
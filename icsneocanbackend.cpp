@@ -5,17 +5,38 @@
 
 #include "icsneocanbackend.h"
 #include "icsneocanbackend_p.h"
+#include "icsneocapturewriter.h"
+#include "icsneoframefilter.h"
+#include "icsneoscheduler.h"
+#include "icsneosupervisor.h"
+#include "icsneotransmitworker.h"
+#include "icsneovirtualdevice.h"
 #include "icsneo/icsneocpp.h"
 #include "include/qticsneo_keys.h"
 
+// Error counters are reported as separate message type - not available in all libicsneo versions,
+// ICSNEO_HAS_ERROR_COUNT_MESSAGE is defined by icsneo.pri when libicsneo checkout provides it
+#ifdef ICSNEO_HAS_ERROR_COUNT_MESSAGE
+#  include "icsneo/communication/message/canerrorcountmessage.h"
+#endif
+
 #include <QtSerialBus/qcanbusdevice.h>
 
 #include <QtCore/qcoreapplication.h>
 #include <QtCore/qcoreevent.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfilesystemwatcher.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qnumeric.h>
 #include <QtCore/qregularexpression.h>
+#include <QtCore/qthreadpool.h>
 #include <QtCore/qtimer.h>
+#include <QtCore/qvarlengtharray.h>
+
+#include <algorithm>
+#include <limits>
+#include <typeinfo>
 
 
 QT_BEGIN_NAMESPACE
@@ -43,11 +64,42 @@ private:
     IcsNeoCanBackendPrivate * const dptr;
 };
 
+void IncomingEventHandler::timerEvent(QTimerEvent *e)
+{
+    if (e->timerId() == dptr->m_receiveTimerId) {
+        dptr->flushReceivedFrames();
+        return;
+    }
+    if (e->timerId() == dptr->m_pollTimerId) {
+        dptr->readAllReceivedMessages();
+        return;
+    }
+    QObject::timerEvent(e);
+}
+
 
 /*-----------------------------------------------------------------------------------------
                              B A C K E N D   P R I V A T E
 -----------------------------------------------------------------------------------------*/
 QMap<QString, std::shared_ptr<icsneo::Device>> IcsNeoCanBackendPrivate::m_devices;
+QVector<IcsNeoCanBackendPrivate::DiscoveredDevice> IcsNeoCanBackendPrivate::m_discovered;
+QList<QCanBusDeviceInfo> IcsNeoCanBackendPrivate::m_interfaces;
+QAtomicInt IcsNeoCanBackendPrivate::m_refreshQueued;
+QElapsedTimer IcsNeoCanBackendPrivate::m_discoveryAge;
+QMutex IcsNeoCanBackendPrivate::m_discoveryGuard;
+QMutex IcsNeoCanBackendPrivate::m_refreshGuard;
+QHash<QString, IcsNeoCanBackendPrivate::ChannelSettings> IcsNeoCanBackendPrivate::m_settingsCache;
+QHash<icsneo::Device *, int> IcsNeoCanBackendPrivate::m_openChannels;
+QMutex IcsNeoCanBackendPrivate::m_settingsGuard;
+QHash<icsneo::Device *, QRecursiveMutex *> IcsNeoCanBackendPrivate::m_sessionGuards;
+QMutex IcsNeoCanBackendPrivate::m_sessionGuardsGuard;
+
+// Device list is probed again in background after this time [ms] - devices without hot-plug
+// notification (Ethernet, non Linux platforms) are discovered this way
+static const qint64 DiscoveryCacheTimeout = 10000;
+
+// Set while this thread dispatches polled messages - they are handed over once the poll is dispatched
+static thread_local bool t_polling = false;
 
 IcsNeoCanBackendPrivate::IcsNeoCanBackendPrivate(IcsNeoCanBackend *q) :
     q_ptr(q),
@@ -56,23 +108,80 @@ IcsNeoCanBackendPrivate::IcsNeoCanBackendPrivate(IcsNeoCanBackend *q) :
 }
 
 
+int IcsNeoCanBackendPrivate::openChannels(icsneo::Device *device)
+{
+    QMutexLocker locker(&m_settingsGuard);
+    return m_openChannels.value(device);
+}
+
+// Device handles are kept across discovery refreshes, so guards live as long as plugin
+QRecursiveMutex *IcsNeoCanBackendPrivate::sessionGuard(icsneo::Device *device)
+{
+    QMutexLocker locker(&m_sessionGuardsGuard);
+    QRecursiveMutex *&guard = m_sessionGuards[device];
+    if (!guard)
+        guard = new QRecursiveMutex;
+    return guard;
+}
+
 bool IcsNeoCanBackendPrivate::setupDevice()
 {
-    Q_Q(IcsNeoCanBackend);
     if(!m_device)
         return false;
 
+    // Refresh and apply are full round-trips to device - skip them when device already has requested settings,
+    // also when openGroup() has just applied them with ParameterFlashKey set
+    if (m_appliedByGroup || settingsUpToDate())
+        return true;
+
+    // Unreadable settings fail open() - defaults are written into device by ResetFactory only
     if (!m_device->settings->refresh())
-        resetController();
+        return false;
+
+    bool res = stageSettings(requestedSettings());
+    if (res) res &= m_device->settings->apply();
+    commitSettings(res);
+
+    return res;
+}
+
+// Every network of aggregate interface is checked - each may have been configured by other channel since
+bool IcsNeoCanBackendPrivate::settingsUpToDate() const
+{
+    Q_Q(const IcsNeoCanBackend);
+    if (q->configurationParameter(ParameterFlashKey).toBool())
+        return false;
+    const ChannelSettings requested = requestedSettings();
+    QMutexLocker locker(&m_settingsGuard);
+    for (const icsneo::Network &network : m_networks)
+    {
+        const auto it = m_settingsCache.constFind(settingsKey(network));
+        if (it == m_settingsCache.constEnd() || !(*it == requested))
+            return false;
+    }
+    return !m_networks.isEmpty();
+}
+
+// Writes configuration of channel into device settings structure without applying it -
+// all networks of aggregate interface get the same configuration
+bool IcsNeoCanBackendPrivate::stageSettings(const ChannelSettings &settings)
+{
+    bool res = m_device!=nullptr;
+    for (const icsneo::Network &network : qAsConst(m_networks))
+        if (res) res &= stageSettings(settings, network);
+    return res;
+}
 
+bool IcsNeoCanBackendPrivate::stageSettings(const ChannelSettings &settings, const icsneo::Network &network)
+{
     QVariant value;
     bool res = m_device!=nullptr;
 
     // Loopback
-    value = q->configurationParameter(QCanBusDevice::LoopbackKey);
+    value = settings.loopback;
     if (value.isValid() && res)
     {
-        CAN_SETTINGS * set = m_device->settings->getMutableCANSettingsFor(m_network);
+        CAN_SETTINGS * set = m_device->settings->getMutableCANSettingsFor(network);
         if (set)
            value.toBool() ? set->Mode = LOOPBACK : set->Mode = NORMAL;
         else
@@ -80,96 +189,404 @@ bool IcsNeoCanBackendPrivate::setupDevice()
     }
 
     // BitRate
-    value = q->configurationParameter(QCanBusDevice::BitRateKey);
+    value = settings.bitRate;
     if (value.isValid() && res)
-        res &= m_device->settings->setBaudrateFor(m_network, value.toInt()) ;
+        res &= m_device->settings->setBaudrateFor(network, value.toInt()) ;
 
     // CanFD Settings
-    value = q->configurationParameter(QCanBusDevice::CanFdKey);
+    value = settings.canFd;
     if (value.toBool() && res)
     {
          /*  NO_CANFD = 0 , CANFD_ENABLED=1, CANFD_BRS_ENABLED=2, CANFD_ENABLED_ISO=3, CANFD_BRS_ENABLED_ISO=4 */
-         CANFD_SETTINGS * canFD = m_device->settings->getMutableCANFDSettingsFor(m_network);
+         CANFD_SETTINGS * canFD = m_device->settings->getMutableCANFDSettingsFor(network);
 
          if (!canFD)
              res = false;
          // Iso
-         value =  q->configurationParameter(ParameterIsoKey);
+         value = settings.iso;
          if (value.isValid() && res)
             value.toBool() ? canFD->FDMode = CANFD_BRS_ENABLED_ISO : canFD->FDMode = CANFD_BRS_ENABLED;
          //res&=m_device->settings->apply();
 
          // FD-Bitrate
-         value = q->configurationParameter(QCanBusDevice::DataBitRateKey);
+         value = settings.dataBitRate;
          if (value.isValid() && res)
-              res &= m_device->settings->setFDBaudrateFor(m_network, value.toInt())  ;
+              res &= m_device->settings->setFDBaudrateFor(network, value.toInt())  ;
          //res&=m_device->settings->apply();
 
          // Termination
-         value = q->configurationParameter(ParameterTerminationKey);
-         if (value.isValid() && res && m_device->settings->canTerminationBeEnabledFor(m_network))
-                m_device->settings->setTerminationFor(m_network,value.toBool());
+         value = settings.termination;
+         if (value.isValid() && res && m_device->settings->canTerminationBeEnabledFor(network))
+                m_device->settings->setTerminationFor(network,value.toBool());
          //res&=m_device->settings->apply();
      }
       else
-      if (res) m_device->settings->getMutableCANFDSettingsFor(m_network)->FDMode = NO_CANFD;
+      if (res) m_device->settings->getMutableCANFDSettingsFor(network)->FDMode = NO_CANFD;
+
+    return res;
+}
+
+void IcsNeoCanBackendPrivate::commitSettings(bool applied)
+{
+    const ChannelSettings requested = requestedSettings();
+    QMutexLocker locker(&m_settingsGuard);
+    for (const icsneo::Network &network : qAsConst(m_networks))
+        if (applied)
+            m_settingsCache.insert(settingsKey(network), requested);
+        else
+            m_settingsCache.remove(settingsKey(network));
+}
+
+/**
+ * Opens channels of the same physical devices with single settings transaction per device -
+ * configuration of all channels is staged and applied once, then each channel is connected.
+ */
+bool IcsNeoCanBackendPrivate::openGroup(const QVector<IcsNeoCanBackend *> &backends)
+{
+    QMap<icsneo::Device *, QVector<IcsNeoCanBackendPrivate *>> devices;
+    for (IcsNeoCanBackend *backend : backends)
+    {
+        IcsNeoCanBackendPrivate *d = backend->d_func();
+        if (backend->state() != QCanBusDevice::UnconnectedState || !d->m_device)
+            continue;
+        devices[d->m_device.get()].append(d);
+    }
+
+    bool res = true;
+    QVector<std::shared_ptr<icsneo::Device>> handedOver;   // opened here for open() of their first channel
+    for (const QVector<IcsNeoCanBackendPrivate *> &channels : qAsConst(devices))
+    {
+        const std::shared_ptr<icsneo::Device> device = channels.first()->m_device;
+        QMutexLocker session(sessionGuard(device.get()));
+        QVector<IcsNeoCanBackendPrivate *> changed;
+        for (IcsNeoCanBackendPrivate *d : channels)
+            if (!d->settingsUpToDate())
+                changed.append(d);
+
+        if (changed.isEmpty())
+            continue;
 
-      value = q->configurationParameter(ParameterFlashKey);
-      if (res ) res &=m_device->settings->apply() ; // !value.toBool());
+        const bool wasOpen = device->isOpen();
+        bool applied = wasOpen || device->open();
+        if (applied) applied &= device->settings->refresh();
+        for (IcsNeoCanBackendPrivate *d : qAsConst(changed))
+            if (applied) applied &= d->stageSettings(d->requestedSettings());
+        if (applied) applied &= device->settings->apply();
+
+        for (IcsNeoCanBackendPrivate *d : qAsConst(changed))
+        {
+            d->commitSettings(applied);
+            d->m_appliedByGroup = applied;
+            if (!applied)
+                d->q_func()->setError(QString::fromStdString(icsneo::GetLastError().describe()),
+                                      QCanBusDevice::ConfigurationError);
+        }
+        if (!wasOpen && device->isOpen())
+            handedOver.append(device);
+        res &= applied;
+    }
 
+    // Settings are in devices already, so open() of each channel goes straight online - devices are
+    // kept open, so their first channel does not open them again
+    for (IcsNeoCanBackend *backend : backends)
+        if (backend->state() == QCanBusDevice::UnconnectedState)
+            res &= backend->connectDevice();
+    for (const QVector<IcsNeoCanBackendPrivate *> &channels : qAsConst(devices))
+        for (IcsNeoCanBackendPrivate *d : channels)
+            d->m_appliedByGroup = false;
+
+    // Device none of whose channels got opened is not left open
+    for (const std::shared_ptr<icsneo::Device> &device : qAsConst(handedOver))
+    {
+        QMutexLocker session(sessionGuard(device.get()));
+        if (openChannels(device.get()) == 0 && device->isOpen())
+            device->close();
+    }
     return res;
 }
 
+IcsNeoCanBackendPrivate::ChannelSettings IcsNeoCanBackendPrivate::requestedSettings() const
+{
+    Q_Q(const IcsNeoCanBackend);
+    ChannelSettings settings;
+    settings.loopback    = q->configurationParameter(QCanBusDevice::LoopbackKey);
+    settings.bitRate     = q->configurationParameter(QCanBusDevice::BitRateKey);
+    settings.canFd       = q->configurationParameter(QCanBusDevice::CanFdKey);
+    settings.iso         = q->configurationParameter(ParameterIsoKey);
+    settings.dataBitRate = q->configurationParameter(QCanBusDevice::DataBitRateKey);
+    settings.termination = q->configurationParameter(ParameterTerminationKey);
+    return settings;
+}
+
+QString IcsNeoCanBackendPrivate::settingsKey(const icsneo::Network &network) const
+{
+    return QString::fromStdString(m_device->getSerial()) + QLatin1Char(':') + QString::number(int(network.getNetID()));
+}
+
+// Called with m_settingsGuard locked. Succeeds when all networks of channel are cached with the same settings.
+bool IcsNeoCanBackendPrivate::cachedSettings(ChannelSettings *settings) const
+{
+    for (int i = 0; i < m_networks.size(); i++)
+    {
+        const auto it = m_settingsCache.constFind(settingsKey(m_networks[i]));
+        if (it == m_settingsCache.constEnd() || (i > 0 && !(*it == *settings)))
+            return false;
+        *settings = *it;
+    }
+    return !m_networks.isEmpty();
+}
+
 bool IcsNeoCanBackendPrivate::open()
 {
     Q_Q(IcsNeoCanBackend);
 
-    if (!m_device.get()) // device does not exist anymore
+    if (!m_device.get() && m_virtualKind.isEmpty()) // device does not exist anymore
         return false;
 
-    bool res =  m_device->open();
+    m_statistics.reset();
+    resetErrorState();
+    m_droppedFrames.store(0, std::memory_order_relaxed);
+    m_reportedDroppedFrames = 0;
+    // Frames are tagged only by aggregate interface. Reserved capacity is kept by resize(0).
+    m_incomingTags.resize(0);
+    m_queuedTags.resize(0);
+    m_queuedTagsBegin = 0;
+    if (m_networks.size() > 1)
+    {
+        m_incomingTags.reserve(m_receiveBatchSize);
+        m_queuedTags.reserve(4 * m_receiveBatchSize);
+    }
+    m_captureFailureReported = false;
+
+    if (!m_captureFile.isEmpty())
+    {
+        QString error;
+        // pcapng interface per network - frames of aggregate interface keep their channel
+        QStringList names { m_interfaceName };
+        if (m_networks.size() > 1)
+        {
+            names.clear();
+            for (quint8 number : qAsConst(m_networkChannels))
+                names << QStringLiteral("can%1.%2").arg(device).arg(number);
+        }
+        m_capture = new IcsNeoCaptureWriter(m_captureFile, names);
+        if (!m_capture->open(&error))
+        {
+            delete m_capture;
+            m_capture = nullptr;
+            q->setError(IcsNeoCanBackend::tr("Cannot open capture file %1: %2").arg(m_captureFile, error),
+                        QCanBusDevice::ConnectionError);
+            return false;
+        }
+    }
+
+    if (!m_virtualKind.isEmpty())
+        return openVirtualDevice();
+
+    QMutexLocker session(sessionGuard(m_device.get()));
+
+    // Messages of network are routed to single channel - interface overlapping opened one (can0.* and
+    // can0.1) is refused before settings of its networks are touched. Session guard keeps routes as checked.
+    const std::shared_ptr<IcsNeoDeviceDispatcher> dispatcher = IcsNeoDeviceDispatcher::forDevice(m_device);
+    for (const icsneo::Network &network : qAsConst(m_networks))
+        if (Q_UNLIKELY(dispatcher->isSubscribed(network.getNetID())))
+        {
+            delete m_capture;
+            m_capture = nullptr;
+            q->setError(IcsNeoCanBackend::tr("Cannot open %1: its network is already received by other opened "
+                                             "interface").arg(m_interfaceName), QCanBusDevice::ConnectionError);
+            return false;
+        }
+
+    // Device is shared by all its channels - it is opened by the first one and closed by the last one
+    const bool firstChannel = openChannels(m_device.get()) == 0;
+
+    bool res =  m_device->isOpen() || m_device->open();
     if (res) res &= setupDevice();
-    if (res) res &= m_device->goOnline();
+    if (res) res &= m_device->isOnline() || m_device->goOnline();
 
     if (nullptr == m_device)
         return false;
 
     if (!res)
     {
-        m_device->close();
+        delete m_capture;
+        m_capture = nullptr;
+        if (firstChannel)
+            m_device->close();
         q->setError(QString::fromStdString(icsneo::GetLastError().describe()),
                     QCanBusDevice::ConnectionError);
     }
     else
     {
-        m_messageCallbackId = m_device->addMessageCallback(icsneo::MessageCallback([=](std::shared_ptr<icsneo::Message> m)
         {
-            QVector<QCanBusFrame> newFrames;
-            auto msg = std::static_pointer_cast<icsneo::CANMessage>(m);
-            QCanBusFrame frame = interpretFrame(msg.get());
-            if (frame.isValid())
-            {
-                newFrames.append(frame);
-                q->enqueueReceivedFrames(newFrames);
-            }
-        } ));
+            QMutexLocker locker(&m_settingsGuard);
+            m_openChannels[m_device.get()]++;
+        }
+        m_channelOpen = true;
+        m_activeSettings = requestedSettings();
+        m_busError.store(false, std::memory_order_relaxed);
+        m_eventCallbackId = icsneo::AddEventCallback(icsneo::EventCallback(
+                                [this](std::shared_ptr<icsneo::APIEvent> event) { eventCallback(event); }));
+        m_receiving.store(true, std::memory_order_release);
+
+        m_dispatcher = dispatcher;
+        for (const icsneo::Network &network : qAsConst(m_networks))
+            m_dispatcher->subscribe(network.getNetID(), this);
+        enableReceiveNotification(true);
+
+        if (m_autoRecovery)
+        {
+            m_dispatcher->acquireSupervision();
+            m_supervised = true;
+        }
+
+        if (m_pollingInterval > 0)
+        {
+            if (m_dispatcher->acquirePolling())
+                m_pollTimerId = incomingEventHandler->startTimer(m_pollingInterval, Qt::PreciseTimer);
+            else
+                qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Cannot enable message polling - using callback");
+        }
+
+        if (m_transmitThreadCapacity > 0)
+        {
+            m_transmitChannel = m_dispatcher->acquireTransmitWorker(this, size_t(m_transmitThreadCapacity),
+                                                                    m_transmitBurst);
+            m_transmitWorker = m_dispatcher->transmitWorker();
+        }
     }
     return res;
 }
 
+// Virtual device delivers messages to the same receive path as libicsneo, but has no dispatcher
+// as it is not shared by several channels
+bool IcsNeoCanBackendPrivate::openVirtualDevice()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    QString error = IcsNeoCanBackend::tr("Unknown virtual device");
+    m_virtualDevice = createVirtualDevice();
+    m_receiving.store(true, std::memory_order_release);
+    enableReceiveNotification(true);
+
+    if (!m_virtualDevice ||
+        !m_virtualDevice->open([this](const icsneo::CANMessage &msg) { messageCallback(msg); }, &error))
+    {
+        m_receiving.store(false, std::memory_order_release);
+        enableReceiveNotification(false);
+        delete m_virtualDevice;
+        m_virtualDevice = nullptr;
+        delete m_capture;
+        m_capture = nullptr;
+        q->setError(IcsNeoCanBackend::tr("Cannot open %1: %2").arg(m_interfaceName, error),
+                    QCanBusDevice::ConnectionError);
+        return false;
+    }
+
+    // Without dispatcher transmit thread serves this channel only
+    if (m_transmitThreadCapacity > 0)
+    {
+        m_transmitWorker = new IcsNeoTransmitWorker;
+        m_transmitChannel = m_transmitWorker->attach(this, size_t(m_transmitThreadCapacity), m_transmitBurst);
+        m_transmitWorker->start(QThread::TimeCriticalPriority);
+    }
+    return true;
+}
+
+IcsNeoVirtualDevice *IcsNeoCanBackendPrivate::createVirtualDevice() const
+{
+    Q_Q(const IcsNeoCanBackend);
+
+    if (m_virtualKind == QLatin1String("replay"))
+        return new IcsNeoReplayDevice(m_replayFile, channel, m_replaySpeed, m_network);
+    if (m_virtualKind == QLatin1String("sim"))
+        return new IcsNeoLoopbackDevice(q->configurationParameter(QCanBusDevice::BitRateKey).toInt(),
+                                        q->configurationParameter(QCanBusDevice::DataBitRateKey).toInt());
+    return nullptr;
+}
+
 void IcsNeoCanBackendPrivate::close()
 {
     Q_Q(IcsNeoCanBackend);
 
+    m_receiving.store(false, std::memory_order_release); // releases callback blocked by full receive buffer
     enableWriteNotification(false);
 
+    if (m_scheduler) {
+        delete m_scheduler; // stops and joins thread
+        m_scheduler = nullptr;
+    }
+
+    if (m_transmitChannel) {
+        if (m_dispatcher)
+            m_dispatcher->releaseTransmitWorker(m_transmitChannel); // joins thread when this is last channel
+        else
+            delete m_transmitWorker; // stops and joins thread
+        m_transmitChannel = nullptr;
+        m_transmitWorker = nullptr;
+    }
+
+    if (m_virtualDevice) {
+        delete m_virtualDevice; // stops delivering messages
+        m_virtualDevice = nullptr;
+    }
+
     if (outgoingEventNotifier) {
         delete outgoingEventNotifier;
         outgoingEventNotifier = nullptr;
     }
 
-    if (m_messageCallbackId)
-        m_device->removeMessageCallback(m_messageCallbackId);
+    if (m_pollTimerId)
+    {
+        incomingEventHandler->killTimer(m_pollTimerId);
+        m_pollTimerId = 0;
+        m_dispatcher->releasePolling();
+    }
+
+    if (m_supervised)
+    {
+        m_dispatcher->releaseSupervision(); // joins supervisor thread when this is last supervised channel
+        m_supervised = false;
+    }
+
+    // Taken after supervisor is joined - it may be waiting for the guard itself
+    QMutexLocker session(m_device ? sessionGuard(m_device.get()) : nullptr);
+
+    if (m_dispatcher)
+    {
+        for (const icsneo::Network &network : qAsConst(m_networks))
+            m_dispatcher->unsubscribe(network.getNetID(), this);
+        m_dispatcher.reset();
+    }
+
+    if (m_eventCallbackId >= 0)
+    {
+        icsneo::RemoveEventCallback(m_eventCallbackId);
+        m_eventCallbackId = -1;
+    }
+
+    enableReceiveNotification(false);
+
+    if (m_capture) {
+        m_capture->close(); // writes pending data and closes file
+        if (m_capture->hasFailed() && !m_captureFailureReported)
+            q->setError(IcsNeoCanBackend::tr("Capture into %1 is incomplete: %2")
+                        .arg(m_captureFile, m_capture->errorString()), QCanBusDevice::OperationError);
+        delete m_capture;
+        m_capture = nullptr;
+    }
+
+    if (!m_channelOpen)
+        return;
+    m_channelOpen = false;
+
+    {
+        QMutexLocker locker(&m_settingsGuard);
+        if (--m_openChannels[m_device.get()] > 0) // other channels of device are still opened
+            return;
+        m_openChannels.remove(m_device.get());
+    }
 
     bool res = m_device->goOffline() && m_device->close();
 
@@ -190,6 +607,230 @@ bool IcsNeoCanBackendPrivate::setConfigurationParameter(int key, const QVariant
         case ParameterIsoKey :                return true;
         case ParameterTerminationKey:         return true;
         case ParameterFlashKey:               return true;
+        case QCanBusDevice::RawFilterKey:
+        {
+            if (Q_UNLIKELY(value.isValid() && !value.canConvert<QList<QCanBusDevice::Filter>>()))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid raw filter list"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            const QList<QCanBusDevice::Filter> filters = value.value<QList<QCanBusDevice::Filter>>();
+            std::shared_ptr<const IcsNeoFrameFilter> filter;
+            if (!filters.isEmpty())
+                filter = std::make_shared<const IcsNeoFrameFilter>(filters);
+            std::atomic_store(&m_frameFilter, filter);
+            return true;
+        }
+        case ParameterTransmitBurstKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            if (Q_UNLIKELY(!ok || number < 1))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid transmit burst size %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_transmitBurst = number;
+            return true;
+        }
+        case ParameterSchedulerSpinKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            if (Q_UNLIKELY(!ok || number < 0))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid scheduler spin time %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_schedulerSpin = number;
+            if (m_scheduler)
+                m_scheduler->setSpin(std::chrono::microseconds(number));
+            return true;
+        }
+        case ParameterTransmitThreadKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            if (Q_UNLIKELY(q->state() == QCanBusDevice::ConnectedState))
+            {
+                q->setError(IcsNeoCanBackend::tr("Cannot configure transmit thread for open device"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            if (Q_UNLIKELY(!ok || number < 0))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid transmit thread queue size %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_transmitThreadCapacity = number;
+            return true;
+        }
+        case ParameterPollingIntervalKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            if (Q_UNLIKELY(q->state() == QCanBusDevice::ConnectedState))
+            {
+                q->setError(IcsNeoCanBackend::tr("Cannot change receive mode of open device"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            if (Q_UNLIKELY(!ok || number < 0))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid polling interval %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            // Polled frames are staged by owner thread, which would wait for itself
+            if (Q_UNLIKELY(number > 0 && m_receiveOverflowPolicy == ReceiveOverflowBlock))
+            {
+                q->setError(IcsNeoCanBackend::tr("Polling receive mode cannot be used with ReceiveOverflowBlock"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_pollingInterval = number;
+            return true;
+        }
+        case ParameterReceiveBufferSizeKey:
+        case ParameterReceiveOverflowPolicyKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            const int maximum = key == ParameterReceiveBufferSizeKey ? std::numeric_limits<int>::max() : ReceiveOverflowBlock;
+            if (Q_UNLIKELY(!ok || number < 0 || number > maximum))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid value %1 for receive buffer parameter %2")
+                            .arg(value.toString()).arg(key), QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            if (Q_UNLIKELY(key == ParameterReceiveOverflowPolicyKey && number == ReceiveOverflowBlock
+                           && m_pollingInterval > 0))
+            {
+                q->setError(IcsNeoCanBackend::tr("ReceiveOverflowBlock cannot be used in polling receive mode"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            QMutexLocker locker(&m_incomingGuard);
+            if (key == ParameterReceiveBufferSizeKey)
+                m_receiveBufferSize = number;
+            else
+                m_receiveOverflowPolicy = number;
+            resizeOverflow();
+            locker.unlock();
+            if (m_receiving.load(std::memory_order_relaxed))
+                enableReceiveNotification(true); // overflow ring needs timer draining it
+            return true;
+        }
+        case ParameterTimestampModeKey:
+        {
+            bool ok = false;
+            const int mode = value.toInt(&ok);
+            if (Q_UNLIKELY(!ok || (mode != TimestampDevice && mode != TimestampHost)))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid timestamp mode %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_timestampMode.store(mode, std::memory_order_relaxed);
+            return true;
+        }
+        case ParameterCaptureFileKey:
+        {
+            if (Q_UNLIKELY(q->state() == QCanBusDevice::ConnectedState))
+            {
+                q->setError(IcsNeoCanBackend::tr("Cannot change capture file of open device"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_captureFile = value.toString();
+            return true;
+        }
+        case ParameterReplayFileKey:
+        case ParameterReplaySpeedKey:
+        {
+            if (Q_UNLIKELY(q->state() == QCanBusDevice::ConnectedState))
+            {
+                q->setError(IcsNeoCanBackend::tr("Cannot change replay of open device"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            if (key == ParameterReplayFileKey)
+            {
+                m_replayFile = value.toString();
+                return true;
+            }
+            bool ok = false;
+            const double speed = value.toDouble(&ok);
+            if (Q_UNLIKELY(!ok || speed < 0.0 || !qIsFinite(speed)))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid replay speed %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_replaySpeed = speed;
+            return true;
+        }
+        case ParameterReceiveBatchSizeKey:
+        case ParameterReceiveLatencyKey:
+        {
+            bool ok = false;
+            const int number = value.toInt(&ok);
+            if (Q_UNLIKELY(!ok || number < (key == ParameterReceiveBatchSizeKey ? 1 : 0)))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid value %1 for receive batch parameter %2")
+                            .arg(value.toString()).arg(key), QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            {
+                QMutexLocker locker(&m_incomingGuard);
+                if (key == ParameterReceiveBatchSizeKey)
+                    m_receiveBatchSize = number;
+                else
+                    m_receiveLatency = number;
+            }
+            if (m_receiveTimerId) // restart with new latency
+            {
+                enableReceiveNotification(false);
+                enableReceiveNotification(true);
+            }
+            return true;
+        }
+        case ParameterAutoRecoveryKey:
+        {
+            if (Q_UNLIKELY(q->state() == QCanBusDevice::ConnectedState))
+            {
+                q->setError(IcsNeoCanBackend::tr("Cannot change recovery of open device"),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_autoRecovery = value.toBool();
+            return true;
+        }
+        case ParameterResetModeKey:
+        {
+            bool ok = false;
+            const int mode = value.toInt(&ok);
+            if (Q_UNLIKELY(!ok || mode < ResetController || mode > ResetFactory))
+            {
+                q->setError(IcsNeoCanBackend::tr("Invalid reset mode %1").arg(value.toString()),
+                            QCanBusDevice::ConfigurationError);
+                return false;
+            }
+            m_resetMode = mode;
+            return true;
+        }
+        case QCanBusDevice::ErrorFilterKey:
+        {
+            const QCanBusFrame::FrameErrors errors = value.canConvert<QCanBusFrame::FrameErrors>()
+                                                   ? value.value<QCanBusFrame::FrameErrors>()
+                                                   : QCanBusFrame::FrameErrors(value.toInt());
+            m_errorFilter.store(int(errors), std::memory_order_relaxed);
+            return true;
+        }
         case QCanBusDevice::ReceiveOwnKey:
         {
             if (Q_UNLIKELY(q->state() != QCanBusDevice::UnconnectedState))
@@ -207,280 +848,1447 @@ bool IcsNeoCanBackendPrivate::setConfigurationParameter(int key, const QVariant
             return false;
         }
     }
-}
-
-bool IcsNeoCanBackendPrivate::setupChannel(const QString &interfaceName)
-{
-    Q_Q(IcsNeoCanBackend);
+}
+
+// Splits interface name kindX.Y[,Z...] or kindX.* into its parts - channels are left empty for wildcard
+bool IcsNeoCanBackendPrivate::parseInterfaceName(const QString &interfaceName, QString *kind, quint8 *deviceNumber,
+                                                 QVector<quint8> *channels)
+{
+    const QRegularExpression re(QStringLiteral("^(can|replay|sim)(\\d+)\\.(\\*|\\d+(?:,\\d+)*)$"));
+    const QRegularExpressionMatch match = re.match(interfaceName);
+    if (!match.hasMatch())
+        return false;
+
+    *kind = match.captured(1);
+    *deviceNumber = quint8(match.captured(2).toUShort());
+    channels->clear();
+    if (match.captured(3) == QLatin1String("*"))
+        return true;
+
+    for (const QString &number : match.captured(3).split(QLatin1Char(',')))
+        if (!channels->contains(quint8(number.toUShort())))
+            channels->append(quint8(number.toUShort()));
+    return true;
+}
+
+bool IcsNeoCanBackendPrivate::setupChannel(const QString &interfaceName)
+{
+    Q_Q(IcsNeoCanBackend);
+
+    QString kind;
+    quint8 deviceNumber = 255;
+    QVector<quint8> channels;
+    const bool parsed = parseInterfaceName(interfaceName, &kind, &deviceNumber, &channels);
+    const bool isVirtual = kind != QLatin1String("can");
+    const bool isAggregate = isAggregateInterface(interfaceName);
+
+    // canX.* stands for all CAN networks of device
+    if (Q_LIKELY(parsed) && m_device && channels.isEmpty())
+    {
+        for (int number = 0; number < MaxAggregatedNetworks; number++)
+            if (m_device->getNetworkByNumber(icsneo::Network::Type::CAN, size_t(number+1)).getNetID()
+                    != icsneo::Network::NetID::Invalid)
+                channels.append(quint8(number));
+    }
+
+    if (Q_LIKELY(parsed) && (m_device || isVirtual) && !(isVirtual && isAggregate)
+            && !channels.isEmpty() && channels.size() <= MaxAggregatedNetworks)
+    {
+        device = deviceNumber;
+        channel = channels.first();
+        m_interfaceName = interfaceName;
+        if (isVirtual)
+        {
+            // Replayed channel is selected by pcapng interface id, simulated channels are independent
+            m_virtualKind = kind;
+            m_network = icsneo::Network(icsneo::Network::NetID::HSCAN);
+        }
+        else
+            m_network = m_device->getNetworkByNumber(icsneo::Network::Type::CAN, channel+1);
+
+        m_networks = { m_network };
+        m_networkChannels = { channel };
+        for (int i = 1; i < channels.size(); i++)
+        {
+            m_networks.append(m_device->getNetworkByNumber(icsneo::Network::Type::CAN, channels[i]+1));
+            m_networkChannels.append(channels[i]);
+        }
+        for (int i = 0; i < m_networks.size(); i++)
+            if (Q_UNLIKELY(m_networks[i].getNetID() == icsneo::Network::NetID::Invalid))
+            {
+                q->setError(IcsNeoCanBackend::tr("Interface '%1' has no CAN channel %2.")
+                            .arg(interfaceName).arg(m_networkChannels[i]), QCanBusDevice::ConnectionError);
+                m_networks.clear();
+                m_networkChannels.clear();
+                m_device.reset();   // channel cannot be opened
+                return false;
+            }
+
+        int maxNetId = 0;
+        for (const icsneo::Network &network : qAsConst(m_networks))
+            maxNetId = qMax(maxNetId, int(network.getNetID()));
+        m_networkIndexes.fill(-1, maxNetId + 1);
+        for (int i = 0; i < m_networks.size(); i++)
+            m_networkIndexes[int(m_networks[i].getNetID())] = qint8(i);
+    }
+    else
+    {
+        q->setError(IcsNeoCanBackend::tr("Invalid interface '%1'.")
+                    .arg(interfaceName), QCanBusDevice::ConnectionError);
+        return false;
+    }
+    return true;
+}
+
+void IcsNeoCanBackendPrivate::setupDefaultConfigurations()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    q->setConfigurationParameter(ParameterReceiveBatchSizeKey, m_receiveBatchSize);
+    q->setConfigurationParameter(ParameterReceiveLatencyKey, m_receiveLatency);
+    q->setConfigurationParameter(ParameterTransmitBurstKey, m_transmitBurst);
+    q->setConfigurationParameter(ParameterTransmitThreadKey, m_transmitThreadCapacity);
+    q->setConfigurationParameter(ParameterSchedulerSpinKey, m_schedulerSpin);
+    q->setConfigurationParameter(ParameterPollingIntervalKey, m_pollingInterval);
+    q->setConfigurationParameter(ParameterReceiveBufferSizeKey, m_receiveBufferSize);
+    q->setConfigurationParameter(ParameterReceiveOverflowPolicyKey, m_receiveOverflowPolicy);
+    q->setConfigurationParameter(ParameterTimestampModeKey, m_timestampMode.load(std::memory_order_relaxed));
+    q->setConfigurationParameter(ParameterResetModeKey, m_resetMode);
+    q->setConfigurationParameter(ParameterAutoRecoveryKey, m_autoRecovery);
+    q->setConfigurationParameter(QCanBusDevice::ErrorFilterKey,
+                                 QVariant::fromValue(QCanBusFrame::FrameErrors(QCanBusFrame::AnyError)));
+    if (m_virtualKind == QLatin1String("replay"))
+        q->setConfigurationParameter(ParameterReplaySpeedKey, m_replaySpeed);
+    if (m_virtualKind == QLatin1String("sim"))
+    {
+        // Timing of emulated bus - bit rate 0 echoes frames without delay
+        q->setConfigurationParameter(QCanBusDevice::CanFdKey, true);
+        q->setConfigurationParameter(QCanBusDevice::BitRateKey, 500000);
+        q->setConfigurationParameter(QCanBusDevice::DataBitRateKey, 2000000);
+    }
+
+    if (!m_device)
+        return;
+
+    // Device is opened only when its settings for this channel are not known yet
+    bool known = true;
+    {
+        QMutexLocker locker(&m_settingsGuard);
+        for (const icsneo::Network &network : qAsConst(m_networks))
+            known &= m_settingsCache.contains(settingsKey(network));
+    }
+    if (!known)
+    {
+        QMutexLocker session(sessionGuard(m_device.get()));
+        const bool wasOpen = m_device->isOpen();
+        if (!wasOpen)
+            m_device->open();
+
+        cacheDeviceSettings();
+
+        if (!wasOpen)
+            m_device->close();
+    }
+
+    setupDeviceConfigurations();
+}
+
+// Stores settings of each network of channel as read from device into settings cache
+void IcsNeoCanBackendPrivate::cacheDeviceSettings()
+{
+    for (const icsneo::Network &network : qAsConst(m_networks))
+    {
+        ChannelSettings settings;
+        if (!readDeviceSettings(network, &settings))
+            continue;
+        QMutexLocker locker(&m_settingsGuard);
+        m_settingsCache.insert(settingsKey(network), settings);
+    }
+}
+
+bool IcsNeoCanBackendPrivate::readDeviceSettings(const icsneo::Network &network, ChannelSettings *settings) const
+{
+    const CANFD_SETTINGS * canFD = m_device->settings->getCANFDSettingsFor(network);
+    const CAN_SETTINGS * can = m_device->settings->getCANSettingsFor(network);
+
+    if (!can || !canFD)
+        return false;
+
+    settings->loopback    = bool(can->Mode & LOOPBACK);
+    settings->canFd       = canFD->FDMode != NO_CANFD;
+    settings->iso         = bool(CANFD_BRS_ENABLED_ISO & canFD->FDMode);
+    settings->bitRate     = int(m_device->settings->getBaudrateFor(network));        // standard BitRate
+    settings->dataBitRate = int(m_device->settings->getFDBaudrateFor(network));
+    if (m_device->settings->canTerminationBeEnabledFor(network))
+        settings->termination = m_device->settings->isTerminationEnabledFor(network).value();
+    return true;
+}
+
+// Sets keys of device configuration from settings cache - other keys are left as they are
+void IcsNeoCanBackendPrivate::setupDeviceConfigurations()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    // Aggregate interface gets keys only when all its networks have the same settings
+    ChannelSettings settings;
+    {
+        QMutexLocker locker(&m_settingsGuard);
+        if (!cachedSettings(&settings))
+            return;
+    }
+    q->setConfigurationParameter(QCanBusDevice::LoopbackKey, settings.loopback);
+    q->setConfigurationParameter(QCanBusDevice::CanFdKey, settings.canFd);
+    q->setConfigurationParameter(ParameterIsoKey, settings.iso);
+    q->setConfigurationParameter(ParameterFlashKey, false);
+    if (settings.termination.isValid())
+        q->setConfigurationParameter(ParameterTerminationKey, settings.termination);
+    q->setConfigurationParameter(QCanBusDevice::BitRateKey, settings.bitRate);
+    q->setConfigurationParameter(QCanBusDevice::DataBitRateKey, settings.dataBitRate);
+}
+
+void IcsNeoCanBackendPrivate::enableWriteNotification(bool enable)
+{
+    Q_Q(IcsNeoCanBackend);
+    if (outgoingEventNotifier) {
+        if (enable) {
+            if (!outgoingEventNotifier->isActive())
+                outgoingEventNotifier->start();
+        } else {
+            outgoingEventNotifier->stop();
+        }
+    } else if (enable) {
+        outgoingEventNotifier = new OutgoingEventNotifier(this, q);
+        outgoingEventNotifier->start(0);
+    }
+}
+
+void IcsNeoCanBackendPrivate::startWrite()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    if (!q->hasOutgoingFrames()) {
+        enableWriteNotification(false);
+        return;
+    }
+
+    // Drain up to burst size frames and hand them over to libicsneo at once
+    m_outgoingMessages.clear(); // keeps capacity
+    while (int(m_outgoingMessages.size()) < m_transmitBurst && q->hasOutgoingFrames())
+        m_outgoingMessages.push_back(createMessage(q->dequeueOutgoingFrame()));
+
+    // Frames after failed one are already dequeued - they are reported as not transmitted
+    const int sent = transmit(m_outgoingMessages);
+    if (sent > 0)
+        q->framesWritten(qint64(sent));
+    if (sent < int(m_outgoingMessages.size()))
+        q->setError(writeErrorString(int(m_outgoingMessages.size()) - sent, int(m_outgoingMessages.size())),
+                    QCanBusDevice::WriteError) ;
+
+    if (q->hasOutgoingFrames())
+        enableWriteNotification(true);
+}
+
+std::shared_ptr<icsneo::CANMessage> IcsNeoCanBackendPrivate::createMessage(const QCanBusFrame &frame) const
+{
+    const QByteArray payload = frame.payload();
+
+    auto msg                 = std::make_shared<icsneo::CANMessage>();
+    msg->network             = m_network;
+    msg->arbid               = frame.frameId();
+    msg->isRemote            = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+    msg->isCANFD             = frame.hasFlexibleDataRateFormat();
+    msg->isExtended          = frame.hasExtendedFrameFormat();
+    msg->baudrateSwitch      = frame.hasBitrateSwitch();
+    msg->errorStateIndicator = frame.hasErrorStateIndicator();
+    msg->data.assign(payload.constBegin(), payload.constEnd());
+    return msg;
+}
+
+// Messages are transmitted one by one, in order, till the first failure - libicsneo transmit() of
+// vector does the same, but does not tell how many of them were sent. Returns number of transmitted
+// messages, the rest is counted as transmit errors.
+int IcsNeoCanBackendPrivate::transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages)
+{
+    size_t sent = 0;
+    if (m_virtualDevice)
+        sent = m_virtualDevice->transmit(messages) ? messages.size() : 0;
+    else
+        while (sent < messages.size() && m_device->transmit(messages[sent]))
+            sent++;
+
+    if (sent < messages.size())
+        m_statistics.addTransmitErrors(messages.size() - sent);
+
+    quint64 bytes = 0;
+    for (size_t i = 0; i < sent; i++)
+        bytes += static_cast<const icsneo::CANMessage &>(*messages[i]).data.size();
+    if (sent > 0)
+    {
+        m_statistics.addTransmitted(sent, bytes);
+        clearBusError();
+    }
+    return int(sent);
+}
+
+QString IcsNeoCanBackendPrivate::writeErrorString(int failed, int total)
+{
+    return IcsNeoCanBackend::tr("Cannot transmit %1 of %2 frames: %3").arg(failed).arg(total)
+           .arg(QString::fromStdString(icsneo::GetLastError().describe()));
+}
+
+// May be called from transmit thread
+void IcsNeoCanBackendPrivate::reportFramesWritten(qint64 count)
+{
+    Q_Q(IcsNeoCanBackend);
+    emit q->framesWritten(count);
+}
+
+// May be called from transmit thread - error is set in owner thread of QCanBusDevice
+void IcsNeoCanBackendPrivate::reportWriteError(int failed, int total)
+{
+    Q_Q(IcsNeoCanBackend);
+    const QString error = writeErrorString(failed, total);
+    QMetaObject::invokeMethod(q, [q, error]() {
+        q->setError(error, QCanBusDevice::WriteError);
+    }, Qt::QueuedConnection);
+}
+
+void IcsNeoCanBackendPrivate::enableReceiveNotification(bool enable)
+{
+    {
+        QMutexLocker locker(&m_incomingGuard);
+        resizeOverflow(); // released when receiving stops, so kept frames are handed over below
+    }
+
+    if (enable)
+    {
+        // Overflow ring is drained by the timer too - application reading frames is not notified
+        const bool draining = !m_overflowFrames.isEmpty();
+        if (!m_receiveTimerId && (m_receiveLatency > 0 || draining))
+            m_receiveTimerId = incomingEventHandler->startTimer(qMax(m_receiveLatency, 1), Qt::PreciseTimer);
+    }
+    else
+    {
+        if (m_receiveTimerId)
+            incomingEventHandler->killTimer(m_receiveTimerId);
+        m_receiveTimerId = 0;
+        flushReceivedFrames();
+    }
+}
+
+// Called from libicsneo callback thread. Frames are handed over to QCanBusDevice in batches
+// to avoid a heap allocation, a mutex lock and a queued framesReceived() signal per frame.
+void IcsNeoCanBackendPrivate::stageReceivedFrame(const QCanBusFrame &frame, int networkIndex)
+{
+    {
+        QMutexLocker locker(&m_incomingGuard);
+
+        if (m_receiveBufferSize > 0 && !reserveReceiveSpace(locker))
+            return;
+
+        if (m_incomingFrames.isEmpty())
+            m_incomingAge.start();
+        m_incomingFrames.append(frame);
+        if (m_networks.size() > 1)
+            m_incomingTags.append(char(m_networkChannels.value(networkIndex, channel)));
+
+        if (t_polling || (m_incomingFrames.size() < m_receiveBatchSize && m_incomingAge.elapsed() < m_receiveLatency))
+            return;
+    }
+    flushReceivedFrames();
+}
+
+// Keeps number of frames waiting for application within ParameterReceiveBufferSizeKey.
+// Called with m_incomingGuard locked. Returns false when received frame has to be dropped.
+bool IcsNeoCanBackendPrivate::reserveReceiveSpace(QMutexLocker &locker)
+{
+    Q_Q(IcsNeoCanBackend);
+
+    auto depth = [&]() { return q->framesAvailable() + m_incomingFrames.size(); };
+    if (depth() < m_receiveBufferSize)
+        return true;
+
+    switch (m_receiveOverflowPolicy)
+    {
+    case ReceiveOverflowBlock:
+    {
+        // Owner thread cannot wait for itself to read frames - frame is dropped instead
+        if (QThread::currentThread() == q->thread())
+        {
+            m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        while (m_receiving.load(std::memory_order_acquire) && depth() >= m_receiveBufferSize)
+        {
+            locker.unlock();
+            QThread::msleep(1);
+            locker.relock();
+        }
+        if (depth() < m_receiveBufferSize)
+            return true;
+        m_droppedFrames.fetch_add(1, std::memory_order_relaxed); // channel is being closed
+        return false;
+    }
+    case ReceiveOverflowDropOldest:
+        return true; // bounded by overflow ring when batch is handed over
+    default: // ReceiveOverflowDropNewest
+        m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+}
+
+// ReceiveOverflowDropOldest - QCanBusDevice is given frames only up to ParameterReceiveBufferSizeKey, the rest
+// waits in overflow ring of the same size, which discards its oldest frames when full. Ring is drained as
+// application reads. Called with m_incomingGuard locked - staged batch and its tags are replaced by frames
+// QCanBusDevice has room for.
+void IcsNeoCanBackendPrivate::spillOverflow(QVector<QCanBusFrame> &frames)
+{
+    Q_Q(IcsNeoCanBackend);
+
+    const int capacity = m_overflowFrames.size();
+    const bool tagged = !m_overflowTags.isEmpty();
+    quint64 dropped = 0;
+    for (int i = 0; i < frames.size(); ++i)
+    {
+        if (m_overflowCount == capacity)
+        {
+            m_overflowBegin = (m_overflowBegin + 1) % capacity;
+            --m_overflowCount;
+            ++dropped;
+        }
+        const int pos = (m_overflowBegin + m_overflowCount) % capacity;
+        m_overflowFrames[pos] = frames.at(i);
+        if (tagged)
+            m_overflowTags[pos] = m_incomingTags.at(i);
+        ++m_overflowCount;
+    }
+    if (dropped)
+        m_droppedFrames.fetch_add(dropped, std::memory_order_relaxed);
+
+    const int room = qBound(0, m_receiveBufferSize - int(q->framesAvailable()), m_overflowCount);
+    frames.resize(room);
+    m_incomingTags.resize(tagged ? room : 0);
+    for (int i = 0; i < room; ++i)
+    {
+        frames[i] = m_overflowFrames.at(m_overflowBegin);
+        if (tagged)
+            m_incomingTags[i] = m_overflowTags.at(m_overflowBegin);
+        m_overflowBegin = (m_overflowBegin + 1) % capacity;
+        --m_overflowCount;
+    }
+}
+
+// Called with m_incomingGuard locked when channel is opened or closed or receive buffer parameters change.
+// Oldest frames which do not fit into smaller ring are discarded. Frames of released ring are staged in
+// front of received frames, so they are handed over first.
+void IcsNeoCanBackendPrivate::resizeOverflow()
+{
+    const int capacity = m_receiving.load(std::memory_order_relaxed) && m_receiveBufferSize > 0 &&
+                         m_receiveOverflowPolicy == ReceiveOverflowDropOldest ? m_receiveBufferSize : 0;
+    if (capacity == m_overflowFrames.size())
+        return;
+
+    const bool tagged = !m_overflowTags.isEmpty();
+    QVector<QCanBusFrame> frames;
+    QByteArray tags;
+    frames.reserve(m_overflowCount);
+    for (int i = 0; i < m_overflowCount; ++i)
+    {
+        const int pos = (m_overflowBegin + i) % m_overflowFrames.size();
+        frames.append(m_overflowFrames.at(pos));
+        if (tagged)
+            tags.append(m_overflowTags.at(pos));
+    }
+    m_overflowFrames = QVector<QCanBusFrame>(capacity);
+    m_overflowTags = capacity > 0 && m_networks.size() > 1 ? QByteArray(capacity, '\0') : QByteArray();
+    m_overflowBegin = 0;
+    m_overflowCount = 0;
+
+    if (capacity == 0)
+    {
+        if (frames.isEmpty())
+            return;
+        if (m_incomingFrames.isEmpty())
+            m_incomingAge.start();
+        m_incomingFrames = frames + m_incomingFrames;
+        m_incomingTags.prepend(tags);
+        return;
+    }
+
+    const int excess = qMax(0, frames.size() - capacity);
+    if (excess > 0)
+        m_droppedFrames.fetch_add(quint64(excess), std::memory_order_relaxed);
+    for (int i = excess; i < frames.size(); ++i)
+    {
+        m_overflowFrames[m_overflowCount] = frames.at(i);
+        if (!m_overflowTags.isEmpty())
+            m_overflowTags[m_overflowCount] = tags.at(i);
+        ++m_overflowCount;
+    }
+}
+
+// Hands staged frames over to QCanBusDevice. enqueueReceivedFrames() emits framesReceived() directly
+// when called from owner thread and its slots may read frames or close channels, so no lock is held
+// meanwhile. Only one thread hands over at a time - other threads leave their frames staged for it and
+// return at once, so batches stay in order of reception and no thread waits for slots of another.
+void IcsNeoCanBackendPrivate::flushReceivedFrames()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    QMutexLocker locker(&m_incomingGuard);
+    m_flushRequested = true;
+    if (m_handOverThread)
+        return;
+    m_handOverThread = QThread::currentThread();
+
+    while (m_flushRequested && (!m_incomingFrames.isEmpty() || m_overflowCount > 0))
+    {
+        m_flushRequested = false;
+        if (!m_incomingFrames.isEmpty())
+            m_statistics.addBatchLatency(m_incomingAge.nsecsElapsed());
+
+        // QCanBusDevice shares staging vector instead of copying it when its queue is empty, so staging
+        // alternates between two vectors - vector released by application is refilled without allocation
+        QVector<QCanBusFrame> frames;
+        frames.swap(m_incomingFrames);
+        m_incomingFrames.swap(m_spareFrames);
+        m_incomingFrames.resize(0); // keeps capacity when detached
+        m_incomingFrames.reserve(m_receiveBatchSize);
+        if (!m_overflowFrames.isEmpty())
+            spillOverflow(frames);
+        if (frames.isEmpty()) // QCanBusDevice has no room for frames kept in overflow ring
+        {
+            m_spareFrames.swap(frames);
+            continue;
+        }
+        if (!m_incomingTags.isEmpty())
+        {
+            m_queuedTags.append(m_incomingTags);
+            m_incomingTags.resize(0);
+        }
+        m_handOverInFlight = true;
+        locker.unlock();
+
+        q->enqueueReceivedFrames(frames);
+
+        locker.relock();
+        m_handOverInFlight = false;
+        m_handOverDone.wakeAll();
+        m_spareFrames.swap(frames);
+
+        // Tags of frames already read by application are dropped from front - just skipped till they
+        // make up half of the buffer, so trimming does not move remaining tags on every batch
+        const int excess = m_queuedTags.size() - m_queuedTagsBegin - int(q->framesAvailable());
+        if (excess > 0)
+            m_queuedTagsBegin += excess;
+        if (m_queuedTagsBegin == m_queuedTags.size())
+        {
+            m_queuedTags.resize(0);
+            m_queuedTagsBegin = 0;
+        }
+        else if (m_queuedTagsBegin > m_queuedTags.size() / 2)
+        {
+            m_queuedTags.remove(0, m_queuedTagsBegin);
+            m_queuedTagsBegin = 0;
+        }
+    }
+    m_flushRequested = false;
+    m_handOverThread = nullptr;
+}
+
+// Called with m_incomingGuard locked. Returns tags of last count frames handed over to QCanBusDevice
+// and forgets all queued tags - used when application reads all frames at once.
+QByteArray IcsNeoCanBackendPrivate::takeQueuedTags(int count)
+{
+    const QByteArray tags = m_queuedTags.mid(qMax(m_queuedTagsBegin, m_queuedTags.size() - count));
+    m_queuedTags.resize(0);
+    m_queuedTagsBegin = 0;
+    return tags;
+}
+
+// Reads all received frames together with channel number each frame was received on, which is
+// how frames of aggregate interface are told apart. Frames are in order of reception.
+QVariantMap IcsNeoCanBackendPrivate::readAllFramesWithChannels()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    // Batch being handed over by other thread has its tags queued already, but maybe not its frames.
+    // Batch handed over by this thread is enqueued already - framesReceived() is emitted afterwards.
+    QMutexLocker locker(&m_incomingGuard);
+    while (m_handOverInFlight && m_handOverThread != QThread::currentThread())
+        m_handOverDone.wait(&m_incomingGuard);
+    const QVector<QCanBusFrame> frames = q->readAllFrames();
+    // Single channel interface does not tag its frames
+    const QByteArray channels = m_networks.size() > 1 ? takeQueuedTags(frames.size())
+                                                      : QByteArray(frames.size(), char(channel));
+
+    QVariantMap result;
+    result.insert(QStringLiteral("frames"), QVariant::fromValue(frames));
+    result.insert(QStringLiteral("channels"), channels);
+    return result;
+}
+
+// Polling receive mode - drains all messages of device and hands them over to channels in batches
+void IcsNeoCanBackendPrivate::readAllReceivedMessages()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    // Slot connected to framesReceived() may close channel and release dispatcher while it polls
+    const std::shared_ptr<IcsNeoDeviceDispatcher> dispatcher = m_dispatcher;
+    if (dispatcher && !dispatcher->poll())
+        q->setError(QString::fromStdString(icsneo::GetLastError().describe()),
+                    QCanBusDevice::ReadError) ;
+}
+
+
+// Tiered reset selected by ParameterResetModeKey - only factory reset touches settings in device. libicsneo
+// resets whole device, so ResetController and ResetSession take every opened channel of it offline too.
+void IcsNeoCanBackendPrivate::resetController()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    if (!m_device) // virtual device has no controller
+        return;
+
+    if (m_resetMode != ResetFactory && !m_channelOpen)
+    {
+        q->setError(IcsNeoCanBackend::tr("Cannot reset controller of closed channel"),
+                    QCanBusDevice::OperationError);
+        return;
+    }
+
+    qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Reseting controller of %ls (mode %d)",
+              qUtf16Printable(m_interfaceName), m_resetMode);
+
+    QMutexLocker session(sessionGuard(m_device.get()));
+
+    // Error events reported before reset are over - failure of reset reports its own
+    m_busError.store(false, std::memory_order_relaxed);
+
+    bool res = false;
+    switch (m_resetMode)
+    {
+    case ResetFactory:
+        res = applyFactoryDefaults();
+        if (res)
+            setupDeviceConfigurations(); // keys show settings actually in device
+        break;
+    case ResetSession: res = reopenSession();         break;
+    default:           res = restartNetwork();        break;
+    }
+
+    if (!res)
+    {
+        q->setError(IcsNeoCanBackend::tr("Cannot reset controller: %1")
+                    .arg(QString::fromStdString(icsneo::GetLastError().describe())),
+                    QCanBusDevice::UnknownError);
+        return;
+    }
+
+    resetErrorState();
+}
+
+// libicsneo cannot restart single network - all channels of device go offline for a moment
+bool IcsNeoCanBackendPrivate::restartNetwork()
+{
+    if (m_device->isOnline() && !m_device->goOffline())
+        return false;
+    return m_device->goOnline();
+}
+
+// Same device handle is opened again, as by supervisor recovery - settings already in device are not
+// applied again. All opened channels of device go offline meanwhile.
+bool IcsNeoCanBackendPrivate::reopenSession()
+{
+    return m_dispatcher && m_dispatcher->reopen(false);
+}
+
+// Writes default settings into device EEPROM - configuration of all channels of device is lost
+bool IcsNeoCanBackendPrivate::applyFactoryDefaults()
+{
+    const bool wasOpen = m_device->isOpen();
+    if (!wasOpen && !m_device->open())
+        return false;
+
+    const bool res = m_device->settings->applyDefaults() && m_device->settings->refresh();
+
+    // Cached settings of channels of this device are no longer valid
+    const QString prefix = QString::fromStdString(m_device->getSerial()) + QLatin1Char(':');
+    QMutexLocker locker(&m_settingsGuard);
+    for (auto it = m_settingsCache.begin(); it != m_settingsCache.end(); )
+        it = it.key().startsWith(prefix) ? m_settingsCache.erase(it) : it + 1;
+    locker.unlock();
+    if (res)
+        cacheDeviceSettings();
+
+    if (!wasOpen)
+        m_device->close();
+    return res;
+}
+
+void IcsNeoCanBackendPrivate::messageCallback(const icsneo::CANMessage &msg)
+{
+    // RawFilterKey is evaluated before anything is allocated for the frame
+    const std::shared_ptr<const IcsNeoFrameFilter> filter = std::atomic_load(&m_frameFilter);
+    if (filter)
+    {
+        const quint8 type = msg.error    ? IcsNeoFrameFilter::ErrorBit
+                          : msg.isRemote ? IcsNeoFrameFilter::RemoteBit
+                                         : IcsNeoFrameFilter::DataBit;
+        if (!filter->accepts(msg.arbid, msg.isExtended, type))
+            return;
+    }
+
+    if (m_capture)
+    {
+        const quint32 canId = msg.arbid | (msg.isExtended ? IcsNeoCaptureWriter::ExtendedFlag : 0)
+                                        | (msg.isRemote   ? IcsNeoCaptureWriter::RemoteFlag   : 0)
+                                        | (msg.error      ? IcsNeoCaptureWriter::ErrorFlag    : 0);
+        const quint8 fdFlags = (msg.baudrateSwitch      ? IcsNeoCaptureWriter::BitrateSwitchFlag : 0)
+                             | (msg.errorStateIndicator ? IcsNeoCaptureWriter::ErrorStateFlag    : 0);
+        const quint64 timestamp = m_timestampMode.load(std::memory_order_relaxed) == TimestampHost && m_dispatcher
+                                ? quint64(m_dispatcher->clock().toHost(msg.timestamp))
+                                : msg.timestamp;
+        m_capture->write(quint32(networkIndex(msg.network)), timestamp, canId, msg.data.data(), int(msg.data.size()),
+                         msg.isCANFD, fdFlags);
+    }
+
+    m_statistics.addReceived(msg.data.size(), msg.error);
+    if (!msg.error)
+        clearBusError();
+    if (msg.error && !(m_errorFilter.load(std::memory_order_relaxed) & QCanBusFrame::BusError))
+        return;
+
+    QCanBusFrame frame = interpretFrame(msg);
+    if (frame.isValid())
+        stageReceivedFrame(frame, networkIndex(msg.network));
+}
+
+// Position of network in m_networks - single channel interface has just one network
+int IcsNeoCanBackendPrivate::networkIndex(const icsneo::Network &network) const
+{
+    const int index = m_networkIndexes.value(int(network.getNetID()), -1);
+    return index < 0 ? 0 : index;
+}
+
+void IcsNeoCanBackendPrivate::resetErrorState()
+{
+    for (std::atomic<int> &state : m_networkErrorStates)
+        state.store(ErrorActive, std::memory_order_relaxed);
+    m_errorState.store(ErrorActive, std::memory_order_relaxed);
+}
+
+QCanBusFrame IcsNeoCanBackendPrivate::interpretFrame(const icsneo::CANMessage &msg)
+{
+    // Payload buffer is recycled once application released frames using it
+    const QByteArray data = m_payloadPool.acquire(msg.data.data(), int(msg.data.size()));
+
+    QCanBusFrame frame(msg.arbid, data);
+
+    // libicsneo timestamps are in nanoseconds
+    const qint64 timestamp = m_timestampMode.load(std::memory_order_relaxed) == TimestampHost && m_dispatcher
+                           ? m_dispatcher->clock().toHost(msg.timestamp)
+                           : qint64(msg.timestamp);
+    frame.setTimeStamp(timeStampFromNanoseconds(timestamp));
+    frame.setExtendedFrameFormat(msg.isExtended);
+    frame.setFlexibleDataRateFormat(msg.isCANFD);
+    frame.setErrorStateIndicator(msg.errorStateIndicator);
+
+    //frame.setLocalEcho(msg.transmited); What does it do?
+
+    // libicsneo does not tell kind of error frame seen on bus
+    if (msg.error)
+    {
+        frame.setFrameType(QCanBusFrame::ErrorFrame);
+        frame.setError(QCanBusFrame::BusError);
+    }
+    else if (msg.isRemote)
+        frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    else
+        frame.setFrameType(QCanBusFrame::DataFrame);
+    return frame;
+}
+
+// Device reports error counters on every change - error frame is generated on error state transition
+// with SocketCAN compatible payload: controller status in byte 1, TEC and REC in bytes 6 and 7
+// Aggregate interface reports worst error state of its networks in busStatus().
+void IcsNeoCanBackendPrivate::errorCountCallback(const icsneo::Network &network, quint8 transmitErrors,
+                                                 quint8 receiveErrors, bool busOff, quint64 timestamp)
+{
+    enum ControllerStatus { RxWarning = 0x04, TxWarning = 0x08, RxPassive = 0x10, TxPassive = 0x20, Active = 0x40 };
+
+    const int state = busOff ? ErrorBusOff
+                    : (transmitErrors >= 128 || receiveErrors >= 128) ? ErrorPassive
+                    : (transmitErrors >= 96  || receiveErrors >= 96)  ? ErrorWarning
+                                                                      : ErrorActive;
+    const int index = networkIndex(network);
+    const int previous = m_networkErrorStates[index].exchange(state, std::memory_order_relaxed);
+    if (state == previous)
+        return;
+
+    int worst = ErrorActive;
+    for (int i = 0; i < m_networks.size(); i++)
+        worst = qMax(worst, m_networkErrorStates[i].load(std::memory_order_relaxed));
+    m_errorState.store(worst, std::memory_order_relaxed);
+
+    QByteArray payload(8, 0);
+    payload[6] = char(transmitErrors);
+    payload[7] = char(receiveErrors);
+
+    QCanBusFrame::FrameError error = QCanBusFrame::ControllerError;
+    switch (state)
+    {
+    case ErrorBusOff:
+        error = QCanBusFrame::BusOffError;
+        break;
+    case ErrorPassive:
+        payload[1] = char((transmitErrors >= 128 ? TxPassive : 0) | (receiveErrors >= 128 ? RxPassive : 0));
+        break;
+    case ErrorWarning:
+        payload[1] = char((transmitErrors >= 96 ? TxWarning : 0) | (receiveErrors >= 96 ? RxWarning : 0));
+        break;
+    default:
+        error = previous == ErrorBusOff ? QCanBusFrame::ControllerRestartError : QCanBusFrame::ControllerError;
+        payload[1] = char(Active);
+        break;
+    }
+
+    m_statistics.addErrorFrame();
+    if (!(m_errorFilter.load(std::memory_order_relaxed) & error))
+        return;
+
+    QCanBusFrame frame(QCanBusFrame::ErrorFrame);
+    frame.setError(error);
+    frame.setPayload(payload);
+    const qint64 hostTimestamp = m_timestampMode.load(std::memory_order_relaxed) == TimestampHost && m_dispatcher
+                               ? m_dispatcher->clock().toHost(timestamp)
+                               : qint64(timestamp);
+    frame.setTimeStamp(timeStampFromNanoseconds(hostTimestamp));
+    stageReceivedFrame(frame, index);
+}
+
+// QCanBusFrame::TimeStamp has microsecond resolution - value is rounded instead of truncated
+QCanBusFrame::TimeStamp IcsNeoCanBackendPrivate::timeStampFromNanoseconds(qint64 ns)
+{
+    return QCanBusFrame::TimeStamp::fromMicroSeconds((ns + 500) / 1000);
+}
+
+QCanBusDevice::CanBusStatus IcsNeoCanBackendPrivate::busStatus()
+{
+    Q_Q(IcsNeoCanBackend);
+
+    const quint64 dropped = m_droppedFrames.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDroppedFrames)
+    {
+        const QString warning = IcsNeoCanBackend::tr("Receive buffer overflow - %1 frames dropped")
+                                .arg(dropped - m_reportedDroppedFrames);
+        m_reportedDroppedFrames = dropped;
+        qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Warning: %ls", qUtf16Printable(warning));
+        q->setError(warning, QCanBusDevice::ReadError);
+        return QCanBusDevice::CanBusStatus::Warning;
+    }
+
+    if (m_capture && !m_captureFailureReported && m_capture->hasFailed())
+    {
+        const QString warning = IcsNeoCanBackend::tr("Capture into %1 stopped: %2")
+                                .arg(m_captureFile, m_capture->errorString());
+        m_captureFailureReported = true;
+        qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Warning: %ls", qUtf16Printable(warning));
+        q->setError(warning, QCanBusDevice::OperationError);
+        return QCanBusDevice::CanBusStatus::Warning;
+    }
+
+    if (!m_virtualKind.isEmpty())
+        return m_virtualDevice ? QCanBusDevice::CanBusStatus::Good : QCanBusDevice::CanBusStatus::BusOff;
+
+    // Events are described only when they changed since last call - steady state costs atomic loads only
+    const quint32 generation = m_eventGeneration.load(std::memory_order_acquire);
+    if (generation != m_reportedEventGeneration)
+    {
+        m_reportedEventGeneration = generation;
+
+        std::vector<std::shared_ptr<icsneo::APIEvent>> events;
+        quint32 skipped = 0;
+        {
+            QMutexLocker locker(&m_eventGuard);
+            events.swap(m_pendingEvents);
+            std::swap(skipped, m_skippedEvents);
+        }
+
+        QStringList warnings;
+        for (const std::shared_ptr<icsneo::APIEvent> &event : events)
+            warnings << QString::fromStdString(event->describe());
+        if (skipped)
+            warnings << IcsNeoCanBackend::tr("%1 more events omitted").arg(skipped);
+
+        if (!warnings.isEmpty())
+        {
+            for (const QString &msg : qAsConst(warnings))
+                qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Warning: %ls", qUtf16Printable(msg));
+
+            q->setError(warnings.join("\n"), QCanBusDevice::ConfigurationError);
+            if (!m_busError.load(std::memory_order_relaxed))
+                return QCanBusDevice::CanBusStatus::Warning;
+        }
+    }
 
-    const QRegularExpression re(QStringLiteral("can(\\d)\\.(\\d)"));
-    const QRegularExpressionMatch match = re.match(interfaceName);
+    if (m_busError.load(std::memory_order_relaxed))
+        return QCanBusDevice::CanBusStatus::Error;
 
-    if (Q_LIKELY(match.hasMatch()) && m_device)
+    switch (m_errorState.load(std::memory_order_relaxed))
     {
-        device = quint8(match.captured(1).toUShort());
-        channel = quint8(match.captured(2).toUShort());     
-        m_network = m_device->getNetworkByNumber(icsneo::Network::Type::CAN, channel+1);
+    case ErrorBusOff:  return QCanBusDevice::CanBusStatus::BusOff;
+    case ErrorPassive: return QCanBusDevice::CanBusStatus::Error;
+    case ErrorWarning: return QCanBusDevice::CanBusStatus::Warning;
+    default:           break;
     }
+
+    if (m_device && m_device->isOnline())
+        return QCanBusDevice::CanBusStatus::Good;
     else
-    {
-        q->setError(IcsNeoCanBackend::tr("Invalid interface '%1'.")
-                    .arg(interfaceName), QCanBusDevice::ConnectionError);
-        return false;
-    }
-    return true;
+        return QCanBusDevice::CanBusStatus::BusOff;
 }
 
-void IcsNeoCanBackendPrivate::setupDefaultConfigurations()
+// Called by libicsneo from thread which raised event - events of other devices are ignored.
+// Error is kept until channel is opened again, warnings are reported once by busStatus().
+// Error severity event (failed transmit, failed settings refresh) is not kept for good - device which
+// receives or transmits frames again works. Load first, so steady state does not write shared cache line.
+void IcsNeoCanBackendPrivate::clearBusError()
 {
-    Q_Q(IcsNeoCanBackend);
+    if (Q_UNLIKELY(m_busError.load(std::memory_order_relaxed)))
+        m_busError.store(false, std::memory_order_relaxed);
+}
 
-    if (!m_device)
+void IcsNeoCanBackendPrivate::eventCallback(const std::shared_ptr<icsneo::APIEvent> &event)
+{
+    if (!event || event->getDevice() != m_device.get() ||
+        event->getSeverity() == icsneo::APIEvent::Severity::EventInfo)
         return;
 
-    bool open = m_device->open();
-    Q_UNUSED(open);
-    int bitrate = m_device->settings->getBaudrateFor(m_network);
-    int fdbitrate = m_device->settings->getFDBaudrateFor(m_network);
+    if (event->getSeverity() == icsneo::APIEvent::Severity::Error)
+        m_busError.store(true, std::memory_order_relaxed);
 
-    const CANFD_SETTINGS * canFD = m_device->settings->getCANFDSettingsFor(m_network);
-    const CAN_SETTINGS * can = m_device->settings->getCANSettingsFor(m_network);
-
-    if (can && canFD)
     {
-     bool hasloopback = can->Mode & LOOPBACK;
-     q->setConfigurationParameter(QCanBusDevice::LoopbackKey, hasloopback);
-
-     bool hasCanFD = canFD->FDMode!= NO_CANFD;
-     q->setConfigurationParameter(QCanBusDevice::CanFdKey, hasCanFD);
-
-     bool hasIso = CANFD_BRS_ENABLED_ISO & canFD->FDMode;
-     q->setConfigurationParameter(ParameterIsoKey, hasIso);
-
-     q->setConfigurationParameter(ParameterFlashKey,false);
+        QMutexLocker locker(&m_eventGuard);
+        if (m_pendingEvents.size() < MaxPendingEvents)
+            m_pendingEvents.push_back(event);
+        else
+            m_skippedEvents++;
+    }
+    m_eventGeneration.fetch_add(1, std::memory_order_release);
+}
 
-     if (m_device->settings->canTerminationBeEnabledFor(m_network))
-     {
-        bool hasTermination = m_device->settings->isTerminationEnabledFor(m_network).value();
-        q->setConfigurationParameter(ParameterTerminationKey, hasTermination);
-     }
+QVariantMap IcsNeoCanBackendPrivate::statistics()
+{
+    Q_Q(IcsNeoCanBackend);
 
-     q->setConfigurationParameter(QCanBusDevice::BitRateKey, bitrate);       // standard BitRate
-     q->setConfigurationParameter(QCanBusDevice::DataBitRateKey, fdbitrate);
+    QVariantMap map = m_statistics.snapshot();
+    map.insert(QStringLiteral("droppedFrames"), m_droppedFrames.load(std::memory_order_relaxed));
+    if (m_capture)
+        map.insert(QStringLiteral("captureDroppedFrames"), m_capture->droppedFrames());
+    quint64 recoveries = 0;
+    qint64 downtime = 0;
+    if (m_dispatcher && m_dispatcher->supervisorStatistics(&recoveries, &downtime))
+    {
+        map.insert(QStringLiteral("recoveries"), recoveries);
+        map.insert(QStringLiteral("downtimeMs"), downtime / 1000000.0);
+    }
 
+    int incoming = q->framesAvailable();
+    {
+        QMutexLocker locker(&m_incomingGuard);
+        incoming += m_incomingFrames.size() + m_overflowCount;
     }
-    m_device->close();
+    map.insert(QStringLiteral("incomingQueue"), incoming);
+    map.insert(QStringLiteral("outgoingQueue"), int(q->framesToWrite()) +
+                                                (m_transmitChannel ? IcsNeoTransmitWorker::queued(m_transmitChannel) : 0));
+    return map;
 }
 
-void IcsNeoCanBackendPrivate::enableWriteNotification(bool enable)
+// Served from discovery cache - only the very first call waits for devices to be probed
+void IcsNeoCanBackendPrivate::interfaces( QList<QCanBusDeviceInfo> & list)
 {
-    Q_Q(IcsNeoCanBackend);
-    if (outgoingEventNotifier) {
-        if (enable) {
-            if (!outgoingEventNotifier->isActive())
-                outgoingEventNotifier->start();
-        } else {
-            outgoingEventNotifier->stop();
+    watchHotplug();
+    {
+        QMutexLocker locker(&m_discoveryGuard);
+        if (m_discoveryAge.isValid())
+        {
+            // Expired cache is served as it is while devices are probed again
+            if (m_discoveryAge.hasExpired(DiscoveryCacheTimeout))
+            {
+                m_discoveryAge.start();
+                refreshInBackground();
+            }
+            list.append(m_interfaces);
+            return;
         }
-    } else if (enable) {
-        outgoingEventNotifier = new OutgoingEventNotifier(this, q);
-        outgoingEventNotifier->start(0);
     }
+
+    refreshDevices();
+
+    QMutexLocker locker(&m_discoveryGuard);
+    list.append(m_interfaces);
 }
 
-void IcsNeoCanBackendPrivate::startWrite()
+std::shared_ptr<icsneo::Device> IcsNeoCanBackendPrivate::deviceFor(const QString &interfaceName)
 {
-    Q_Q(IcsNeoCanBackend);
-
-    if (!q->hasOutgoingFrames()) {
-        enableWriteNotification(false);
-        return;
+    // Aggregate interface belongs to device of its first listed channel
+    const QString name = isAggregateInterface(interfaceName)
+                       ? interfaceName.section(QLatin1Char(','), 0, 0).replace(QLatin1Char('*'), QLatin1Char('0'))
+                       : interfaceName;
+    {
+        QMutexLocker locker(&m_discoveryGuard);
+        if (m_devices.contains(name))
+            return m_devices.value(name);
     }
+    // Backend created without prior availableDevices() call, or for device not discovered yet
+    refreshDevices();
 
-    const QCanBusFrame frame = q->dequeueOutgoingFrame();
-    const QByteArray payload = frame.payload();
+    QMutexLocker locker(&m_discoveryGuard);
+    return m_devices.value(name);
+}
 
-    auto msg                 = std::make_shared<icsneo::CANMessage>();
-    msg->network             = m_network;
-    msg->arbid               = frame.frameId();
-    msg->isRemote            = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
-    msg->isCANFD             = m_hasFD;
-    msg->isExtended          = frame.hasExtendedFrameFormat();
-    msg->baudrateSwitch      = frame.hasBitrateSwitch();
-    msg->errorStateIndicator = frame.hasErrorStateIndicator();
-    msg->data.insert(msg->data.end(), payload.begin(), payload.end()) ;
+// Virtual interfaces are not listed by interfaces() and never trigger device discovery
+bool IcsNeoCanBackendPrivate::isVirtualInterface(const QString &interfaceName)
+{
+    return interfaceName.startsWith(QLatin1String("replay")) || interfaceName.startsWith(QLatin1String("sim"));
+}
 
-    if(m_device->transmit(msg))
-        q->framesWritten(qint64(1));
-    else
-        q->setError(QString::fromStdString(icsneo::GetLastError().describe()),
-                    QCanBusDevice::WriteError) ;
+// Aggregate interfaces (canX.* or canX.Y,Z) are not listed by interfaces() - they are composed
+// of listed channels of single device
+bool IcsNeoCanBackendPrivate::isAggregateInterface(const QString &interfaceName)
+{
+    return interfaceName.endsWith(QLatin1String(".*")) || interfaceName.contains(QLatin1Char(','));
+}
 
-    if (q->hasOutgoingFrames())
-        enableWriteNotification(true);
+// Probes all devices - takes seconds, so discovery cache stays available meanwhile and only
+// the result is merged into it. Concurrent refreshes probe one after another.
+void IcsNeoCanBackendPrivate::refreshDevices()
+{
+    QMutexLocker refresh(&m_refreshGuard);
+    QVector<DiscoveredDevice> probed;
+    for (const std::shared_ptr<icsneo::Device> &device : icsneo::FindAllDevices())
+        probed.append(DiscoveredDevice {
+            QString::fromStdString(device->getSerial()),
+            QString::fromStdString(device->describe()) + QString(" - %1").arg(typeid(*device).name()),
+            int(device->getNetworkCountByType(icsneo::Network::Type::CAN)),
+            device });
+    updateDiscovered(probed);
 }
 
-void IcsNeoCanBackendPrivate::readAllReceivedMessages()
+void IcsNeoCanBackendPrivate::refreshInBackground()
+{
+    if (m_refreshQueued.fetchAndStoreOrdered(1))
+        return;
+    QThreadPool::globalInstance()->start([]() {
+        m_refreshQueued.storeRelease(0); // change seen from now on needs next refresh
+        refreshDevices();
+    });
+}
+
+// Merges probed devices into discovery cache. Handles of devices already known by serial number
+// are kept, so backends holding them are not affected by refresh.
+void IcsNeoCanBackendPrivate::updateDiscovered(const QVector<DiscoveredDevice> &probed)
 {
-    //@TODO this is generic implementation based on Qt CanBus module will not work till polling is not enabled
-    // Attempt to get messages, limiting the number of messages at once to 50,000
-    // A third parameter of type std::chrono::milliseconds is also accepted if a timeout is desired
+    QMutexLocker locker(&m_discoveryGuard);
 
-    Q_Q(IcsNeoCanBackend);
-    QVector<QCanBusFrame> newFrames;
-    std::vector<std::shared_ptr<icsneo::Message>> msgs;
-    if(!m_device->getMessages(msgs, 50000, std::chrono::milliseconds(500)))
+    QVector<bool> present(m_discovered.size(), false);
+    for (const DiscoveredDevice &found : probed)
     {
-        q->setError(QString::fromStdString(icsneo::GetLastError().describe()),
-                    QCanBusDevice::ReadError) ;
-        return;
+        auto it = std::find_if(m_discovered.begin(), m_discovered.end(),
+                               [&found](const DiscoveredDevice &known) { return known.serial == found.serial; });
+        if (it == m_discovered.end())
+        {
+            m_discovered.append(found);
+            present.append(true);
+            continue;
+        }
+        if (!it->device)
+            *it = found;
+        present[int(it - m_discovered.begin())] = true;
     }
 
-    for (auto m: msgs)
+    // Unplugged devices - handle is released unless device is still opened by some backend
+    for (int i = 0; i < m_discovered.size(); i++)
     {
-        auto msg = std::static_pointer_cast<icsneo::CANMessage>(m);
-        QCanBusFrame frame = interpretFrame(msg.get());
-        if (frame.isValid())
-            newFrames.append(std::move(frame));
+        std::shared_ptr<icsneo::Device> &device = m_discovered[i].device;
+        if (!present[i] && device && !device->isOpen())
+            device.reset();
     }
-    q->enqueueReceivedFrames(newFrames);
-}
 
+    m_devices.clear();
+    m_interfaces.clear();
+    for (int i = 0 ; i < m_discovered.size() ; i++)
+    {
+        const DiscoveredDevice &device = m_discovered[i];
+        if (!present[i] && !device.device)
+            continue;
+        for (int channel = 0 ; channel < device.channels ; channel++)
+        {
+            QCanBusDeviceInfo info = IcsNeoCanBackend::createDeviceInfo(device.serial, device.description, uint(i), channel);
+            m_devices[info.name()] = device.device;
+            m_interfaces.append(std::move(info));
+        }
+    }
+    m_discoveryAge.start();
+}
 
-void IcsNeoCanBackendPrivate::resetController()
+// Probes devices in background when USB device nodes change, so USB devices are picked up
+// before the cache expires. Does nothing on platforms without hot-plug notifications.
+void IcsNeoCanBackendPrivate::watchHotplug()
 {
+#if defined(Q_OS_LINUX)
+    static QAtomicInt started;
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app || started.fetchAndStoreOrdered(1))
+        return;
 
-    auto uniqDevString =[=](const std::shared_ptr<icsneo::Device> & device ) {
-        QString str = QString::fromStdString(device->describe()) + QString(" - %1").arg(typeid(m_device).name());
-        str+= QString::fromStdString(device->getSerial());
-        return str;
-    };
-
-    qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Reseting controller");
+    // Watcher is created in main thread, availableDevices() may be called from any thread
+    QMetaObject::invokeMethod(app, [app]() {
+        static const QString usbRoot = QStringLiteral("/dev/bus/usb");
+        QFileSystemWatcher *watcher = new QFileSystemWatcher(app);
+        auto watchBuses = [watcher]() {
+            QStringList paths { usbRoot };
+            for (const QString &bus : QDir(usbRoot).entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+                paths << usbRoot + QLatin1Char('/') + bus;
+            watcher->addPaths(paths);
+        };
+        watchBuses();
+
+        QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, watcher, [watchBuses](const QString &path) {
+            refreshInBackground();
+            if (path == usbRoot)
+                watchBuses();
+        });
+    });
+#endif
+}
 
-    Q_Q(IcsNeoCanBackend);
-    QString description = uniqDevString(m_device);
+/*-----------------------------------------------------------------------------------------
+                             D E V I C E   D I S P A T C H E R
+-----------------------------------------------------------------------------------------*/
+QMap<icsneo::Device *, std::weak_ptr<IcsNeoDeviceDispatcher>> IcsNeoDeviceDispatcher::m_dispatchers;
+QMutex IcsNeoDeviceDispatcher::m_dispatchersGuard;
 
-    this->close();              // Close current connection
+// Backends this thread is delivering messages to - unsubscribe() called from within the delivery
+// does not wait for itself
+static thread_local QVarLengthArray<const IcsNeoCanBackendPrivate *, 4> t_delivering;
 
-    m_device->settings->applyDefaults(); // setupd default settings
-    m_device->settings->apply();         // write into device EEPROM memory
+IcsNeoDeviceDispatcher::IcsNeoDeviceDispatcher(const std::shared_ptr<icsneo::Device> &device) :
+    m_device(device)
+{
+    m_callbackId = m_device->addMessageCallback(icsneo::MessageCallback([this](std::shared_ptr<icsneo::Message> m)
+    {
+        dispatch(m);
+    }));
+}
 
-    delete m_device.get();      // Delete current device
-    m_device.reset();           // Reset variable
+IcsNeoDeviceDispatcher::~IcsNeoDeviceDispatcher()
+{
+    delete m_supervisor;
+    delete m_transmitWorker;
+    if (m_callbackId)
+        m_device->removeMessageCallback(m_callbackId);
+
+    // Runs on thread which released last reference - entry may already belong to new dispatcher
+    QMutexLocker locker(&m_dispatchersGuard);
+    auto it = m_dispatchers.find(m_device.get());
+    if (it != m_dispatchers.end() && it->expired())
+        m_dispatchers.erase(it);
+}
 
-    // Restore device handler
-    std::vector<std::shared_ptr<icsneo::Device>>  devices = icsneo::FindAllDevices();
-    for (auto dev : devices)
+std::shared_ptr<IcsNeoDeviceDispatcher> IcsNeoDeviceDispatcher::forDevice(const std::shared_ptr<icsneo::Device> &device)
+{
+    QMutexLocker locker(&m_dispatchersGuard);
+    std::shared_ptr<IcsNeoDeviceDispatcher> dispatcher = m_dispatchers.value(device.get()).lock();
+    if (!dispatcher)
     {
-        QString dev_description =   uniqDevString(dev);
+        dispatcher = std::make_shared<IcsNeoDeviceDispatcher>(device);
+        m_dispatchers[device.get()] = dispatcher;
+    }
+    return dispatcher;
+}
+
+void IcsNeoDeviceDispatcher::subscribe(icsneo::Network::NetID netId, IcsNeoCanBackendPrivate *backend)
+{
+    const int index = int(netId);
+    QWriteLocker locker(&m_routesGuard);
+    if (index >= m_routes.size())
+        m_routes.resize(index + 1);
+    m_routes[index] = backend;
+}
 
+bool IcsNeoDeviceDispatcher::isSubscribed(icsneo::Network::NetID netId)
+{
+    const int index = int(netId);
+    QReadLocker locker(&m_routesGuard);
+    return index < m_routes.size() && m_routes[index];
+}
 
-       if (dev_description == description )
-       {
-           m_device = dev ;
-           dev.reset();
-           break;
-       }
+void IcsNeoDeviceDispatcher::unsubscribe(icsneo::Network::NetID netId, IcsNeoCanBackendPrivate *backend)
+{
+    const int index = int(netId);
+    {
+        QWriteLocker locker(&m_routesGuard);
+        if (index < m_routes.size() && m_routes[index] == backend)
+            m_routes[index] = nullptr;
     }
 
-    if (nullptr == m_device )
+    // Message dispatched before route was removed may still be handled by backend. Delivery this
+    // thread is nested in (channel closed by slot connected to framesReceived()) is not waited for.
+    const int own = int(std::count(t_delivering.cbegin(), t_delivering.cend(), backend));
+    while (backend->m_dispatching.load(std::memory_order_acquire) > own)
+        QThread::yieldCurrentThread();
+}
+
+bool IcsNeoDeviceDispatcher::acquirePolling()
+{
+    QMutexLocker locker(&m_pollGuard);
+    if (m_pollingChannels++ > 0)
+        return true;
+
+    if (m_callbackId)
+        m_device->removeMessageCallback(m_callbackId);
+    m_callbackId = 0;
+
+    if (m_device->enableMessagePolling())
+        return true;
+
+    // Fall back to callback
+    m_pollingChannels = 0;
+    m_callbackId = m_device->addMessageCallback(icsneo::MessageCallback([this](std::shared_ptr<icsneo::Message> m)
     {
-        q->setError(IcsNeoCanBackend::tr("Cannot reset controller. Try unplug and plug deivce again"),
-                    QCanBusDevice::UnknownError);
+        dispatch(m);
+    }));
+    return false;
+}
+
+void IcsNeoDeviceDispatcher::releasePolling()
+{
+    QMutexLocker locker(&m_pollGuard);
+    if (m_pollingChannels == 0 || --m_pollingChannels > 0)
         return;
-    }
 
-    // Resored opened state;
-    if (q->state() == QCanBusDevice::ConnectedState)
+    m_device->disableMessagePolling();
+    m_callbackId = m_device->addMessageCallback(icsneo::MessageCallback([this](std::shared_ptr<icsneo::Message> m)
     {
-       q->setState(QCanBusDevice::UnconnectedState);
-       q->open();
-    }
+        dispatch(m);
+    }));
 }
 
-QCanBusFrame IcsNeoCanBackendPrivate::interpretFrame( icsneo::CANMessage * msg )
+// Channels of device may be opened and closed from different threads. Supervisor thread never takes
+// m_supervisionGuard, so it is joined with the guard held.
+void IcsNeoDeviceDispatcher::acquireSupervision()
 {
-    if (!(icsneo::Network::Type::CAN == msg->network.getType() &&
-          msg->network.getNetID() == m_network.getNetID() ) )
-        return QCanBusFrame(QCanBusFrame::InvalidFrame);
+    QMutexLocker locker(&m_supervisionGuard);
+    if (m_supervisedChannels++ > 0)
+        return;
+    m_supervisor = new IcsNeoDeviceSupervisor(this, m_device);
+    m_supervisor->start();
+}
 
-    QByteArray data;
-    for (auto b : msg->data)
-        data.append(b);
+void IcsNeoDeviceDispatcher::releaseSupervision()
+{
+    QMutexLocker locker(&m_supervisionGuard);
+    if (m_supervisedChannels == 0 || --m_supervisedChannels > 0)
+        return;
+    delete m_supervisor; // stops and joins thread
+    m_supervisor = nullptr;
+}
 
-    QCanBusFrame frame(msg->arbid, data);
+bool IcsNeoDeviceDispatcher::supervisorStatistics(quint64 *recoveries, qint64 *downtime)
+{
+    QMutexLocker locker(&m_supervisionGuard);
+    if (!m_supervisor)
+        return false;
+    *recoveries = m_supervisor->recoveries();
+    *downtime = m_supervisor->downtime();
+    return true;
+}
 
-    //qDebug() << "Message timestamp:" << msg->timestamp << " Sec:" << msg->timestamp / 1000000 << "." << msg->timestamp % 1000000;
-    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(msg->timestamp));
-    frame.setExtendedFrameFormat(msg->isExtended);
-    frame.setFlexibleDataRateFormat(msg->isCANFD);
-    frame.setErrorStateIndicator(msg->errorStateIndicator);
+// Single thread transmits for all channels, so they do not compete for driver. Transmit thread
+// never takes m_transmitGuard, so it is joined with the guard held.
+IcsNeoTransmitWorker::Channel *IcsNeoDeviceDispatcher::acquireTransmitWorker(IcsNeoCanBackendPrivate *backend,
+                                                                             size_t capacity, int burst)
+{
+    QMutexLocker locker(&m_transmitGuard);
+    if (m_transmitChannels++ == 0)
+    {
+        m_transmitWorker = new IcsNeoTransmitWorker;
+        m_transmitWorker->start(QThread::TimeCriticalPriority);
+    }
+    return m_transmitWorker->attach(backend, capacity, burst);
+}
 
-    //frame.setLocalEcho(msg->transmited); What does it do?
+void IcsNeoDeviceDispatcher::releaseTransmitWorker(IcsNeoTransmitWorker::Channel *channel)
+{
+    QMutexLocker locker(&m_transmitGuard);
+    if (m_transmitChannels == 0)
+        return;
+    m_transmitWorker->detach(channel);
+    if (--m_transmitChannels > 0)
+        return;
+    delete m_transmitWorker; // stops and joins thread
+    m_transmitWorker = nullptr;
+}
 
-    if (msg->error)
-        frame.setFrameType(QCanBusFrame::ErrorFrame);
-    else if (msg->isRemote)
-        frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-    else
-        frame.setFrameType(QCanBusFrame::DataFrame);
-    return frame;
+bool IcsNeoDeviceDispatcher::anyBusOff()
+{
+    QReadLocker locker(&m_routesGuard);
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(m_routes))
+        if (backend && backend->m_errorState.load(std::memory_order_relaxed) == IcsNeoCanBackendPrivate::ErrorBusOff)
+            return true;
+    return false;
 }
 
-QCanBusDevice::CanBusStatus IcsNeoCanBackendPrivate::busStatus()
+// Called from supervisor thread - settings the channels were opened with are staged again
+bool IcsNeoDeviceDispatcher::restoreSettings()
 {
-    Q_Q(IcsNeoCanBackend);
+    QReadLocker locker(&m_routesGuard);
+    bool res = true;
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(m_routes))
+        if (backend && res)
+            res &= backend->stageSettings(backend->m_activeSettings);
+    return res;
+}
 
-    icsneo::APIEvent event = icsneo::GetLastError();
-    if (event.getDevice() == m_device.get() && event.getSeverity() == icsneo::APIEvent::Severity::Error)
-    {        
-          QString error = QString::fromStdString(event.describe());
-          q->setError(error, QCanBusDevice::ConfigurationError);
-          return QCanBusDevice::CanBusStatus::Error;
-    }
+// Called with session guard of device held. Receiving of all channels is registered again once device is
+// online - with settings of opened channels applied again first, when device may have lost them.
+bool IcsNeoDeviceDispatcher::reopen(bool reapplySettings)
+{
+    if (m_device->isOnline())
+        m_device->goOffline();
+    if (m_device->isOpen())
+        m_device->close();
 
-    QStringList  warnings;
-    for( auto & event : GetEvents(icsneo::EventFilter()) )
-          warnings <<  QString::fromStdString(event.describe());
+    bool res = m_device->open();
+    if (res && reapplySettings)
+    {
+        res &= m_device->settings->refresh();
+        if (res) res &= restoreSettings();
+        if (res) res &= m_device->settings->apply();
+    }
+    if (res) res &= m_device->goOnline();
+    if (res)
+        reattach();
+    return res;
+}
 
-   // if (q->configurationParameter(ParameterOmitKey).toBool())
-   //    warnings << "Configuration ommited - using device defaults";
+// Called after device was opened again - receiving is registered again
+void IcsNeoDeviceDispatcher::reattach()
+{
+    QMutexLocker locker(&m_pollGuard);
+    if (m_pollingChannels > 0)
+    {
+        m_device->enableMessagePolling();
+        return;
+    }
 
-    if (!warnings.isEmpty())
+    if (m_callbackId)
+        m_device->removeMessageCallback(m_callbackId);
+    m_callbackId = m_device->addMessageCallback(icsneo::MessageCallback([this](std::shared_ptr<icsneo::Message> m)
     {
-        for(auto msg: warnings)
-            qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "Warning: %ls", qUtf16Printable(msg));
+        dispatch(m);
+    }));
+}
 
-        q->setError(warnings.join("\n"), QCanBusDevice::ConfigurationError);
-        return QCanBusDevice::CanBusStatus::Warning;
+// Called from supervisor thread after successful recovery
+void IcsNeoDeviceDispatcher::recovered()
+{
+    QReadLocker locker(&m_routesGuard);
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(m_routes))
+        if (backend)
+        {
+            backend->resetErrorState(); // bus off is left, as after resetController()
+            backend->m_busError.store(false, std::memory_order_relaxed);
+        }
+}
+
+// Non-blocking drain of messages polled by libicsneo. Message vector is reused between polls.
+// Frames are handed over with no lock held - slots connected to framesReceived() run from here
+// and may close channels of device.
+bool IcsNeoDeviceDispatcher::poll()
+{
+    std::vector<std::shared_ptr<icsneo::Message>> messages;
+    {
+        QMutexLocker locker(&m_pollGuard);
+        if (!m_device->getMessages(m_polledMessages, 0, std::chrono::milliseconds(0)))
+            return false;
+        messages.swap(m_polledMessages);
     }
 
-    if (m_device->isOnline())
-        return QCanBusDevice::CanBusStatus::Good;
-    else
-        return QCanBusDevice::CanBusStatus::BusOff;
+    t_polling = true;
+    for (const std::shared_ptr<icsneo::Message> &message : messages)
+        dispatch(message);
+    t_polling = false;
 
-    return QCanBusDevice::CanBusStatus::Unknown;
+    messages.clear();
+    {
+        QMutexLocker locker(&m_pollGuard);
+        if (m_polledMessages.empty())
+            m_polledMessages.swap(messages);
+    }
+
+    // Whole poll goes to QCanBusDevice as single batch per channel. Backends are marked as being
+    // delivered to, so channel closed meanwhile stays valid till the end of loop.
+    QVarLengthArray<IcsNeoCanBackendPrivate *, 16> backends;
+    {
+        QReadLocker routesLocker(&m_routesGuard);
+        for (IcsNeoCanBackendPrivate *backend : qAsConst(m_routes))
+            if (backend && !backends.contains(backend)) // aggregate interface has route per network
+            {
+                backend->m_dispatching.fetch_add(1, std::memory_order_acquire);
+                backends.append(backend);
+            }
+    }
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(backends))
+        t_delivering.append(backend);
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(backends))
+        backend->flushReceivedFrames();
+    t_delivering.resize(t_delivering.size() - backends.size());
+    for (IcsNeoCanBackendPrivate *backend : qAsConst(backends))
+        backend->m_dispatching.fetch_sub(1, std::memory_order_release);
+    return true;
 }
 
-void IcsNeoCanBackendPrivate::interfaces( QList<QCanBusDeviceInfo> & list)
+// Called from libicsneo callback thread or from poll()
+void IcsNeoDeviceDispatcher::dispatch(const std::shared_ptr<icsneo::Message> &message)
 {
-    m_devices.clear();
-    std::vector<std::shared_ptr<icsneo::Device>>  devices = icsneo::FindAllDevices();
-    for (unsigned int i = 0 ; i < devices.size() ; i++)
+    if (icsneo::Network::Type::CAN != message->network.getType())
+        return;
+
+    const int index = int(message->network.getNetID());
+    // Route lock is not held while backend handles message - callback blocked by full receive
+    // buffer must not block subscribe() / unsubscribe() of other channels
+    IcsNeoCanBackendPrivate *backend = nullptr;
     {
-        std::shared_ptr<icsneo::Device> & device = devices[i];
-        int channels = device->getNetworkCountByType(icsneo::Network::Type::CAN);
-        for (int channel = 0 ; channel < channels ; channel++)
-        {
-            QString description =   QString::fromStdString(device->describe()) + QString(" - %1").arg(typeid(*device).name());
-            QString serial      = QString::fromStdString(device->getSerial());
-            QCanBusDeviceInfo info = IcsNeoCanBackend::createDeviceInfo(serial, description, i, channel);
-            m_devices[info.name()] = device;
-            list.append(std::move(info));
-        }
+        QReadLocker locker(&m_routesGuard);
+        if (index >= m_routes.size() || !m_routes[index])
+            return;
+        backend = m_routes[index];
+        backend->m_dispatching.fetch_add(1, std::memory_order_acquire);
+    }
+    t_delivering.append(backend);
+
+    // Error counter changes come on CAN network too, but as different message type
+    const icsneo::Message &msg = *message;
+    if (typeid(msg) == typeid(icsneo::CANMessage))
+    {
+        // Clock is correlated on routed CAN frames only - other traffic may carry other timebase
+        m_clock.addSample(message->timestamp, IcsNeoClockCorrelator::hostNow());
+        backend->messageCallback(static_cast<const icsneo::CANMessage &>(msg));
+    }
+#ifdef ICSNEO_HAS_ERROR_COUNT_MESSAGE
+    else if (typeid(msg) == typeid(icsneo::CANErrorCountMessage))
+    {
+        const auto &counts = static_cast<const icsneo::CANErrorCountMessage &>(msg);
+        backend->errorCountCallback(counts.network, counts.transmitErrorCount, counts.receiveErrorCount,
+                                    counts.busOff, counts.timestamp);
     }
+#endif
+
+    t_delivering.removeLast();
+    backend->m_dispatching.fetch_sub(1, std::memory_order_release);
 }
 
 /*-----------------------------------------------------------------------------------------
@@ -491,7 +2299,8 @@ IcsNeoCanBackend::IcsNeoCanBackend(const QString &name, QObject *parent) :
     d_ptr(new IcsNeoCanBackendPrivate(this))
 {
     Q_D(IcsNeoCanBackend);
-    d_ptr->m_device = IcsNeoCanBackendPrivate::m_devices[name];
+    if (!IcsNeoCanBackendPrivate::isVirtualInterface(name))
+        d_ptr->m_device = IcsNeoCanBackendPrivate::deviceFor(name);
     d->setupChannel(name);
     d->setupDefaultConfigurations();
     std::function<void()> f = std::bind(&IcsNeoCanBackend::resetController, this);
@@ -527,7 +2336,19 @@ QList<QCanBusDeviceInfo> IcsNeoCanBackend::interfaces()
 
 QString IcsNeoCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
-    //@TODO - this is stupid ... and not usable as error frame is not set anywhere
+    // Controller error frames carry SocketCAN compatible status and error counters
+    if ((errorFrame.error() & QCanBusFrame::ControllerError) && errorFrame.payload().size() >= 8)
+    {
+        const QByteArray payload = errorFrame.payload();
+        const quint8 status = quint8(payload[1]);
+        const QString state = status & 0x30 ? QStringLiteral("error passive")
+                            : status & 0x0C ? QStringLiteral("error warning")
+                            : status & 0x40 ? QStringLiteral("error active")
+                                            : QStringLiteral("unknown state");
+        return QStringLiteral("Controller %1 (TEC %2, REC %3)")
+               .arg(state).arg(quint8(payload[6])).arg(quint8(payload[7]));
+    }
+
     switch (errorFrame.error())
     {
     case QCanBusFrame::TransmissionTimeoutError   : return "Transmission timeout";
@@ -604,11 +2425,121 @@ bool IcsNeoCanBackend::writeFrame(const QCanBusFrame &newData)
                  QCanBusDevice::WriteError);
         return false;
     }
+
+    if (d->m_transmitWorker)
+    {
+        if (Q_UNLIKELY(!d->m_transmitWorker->enqueue(d->m_transmitChannel, newData)))
+        {
+            setError(tr("Transmit queue is full"), QCanBusDevice::WriteError);
+            return false;
+        }
+        return true;
+    }
+
     enqueueOutgoingFrame(newData);
     d->enableWriteNotification(true);
     return true;
 }
 
+/**
+ * Registers frame transmitted every periodUs microseconds by scheduler thread of backend.
+ * count <= 0 - transmitted until removed. Each element of mutators is QVariantMap describing
+ * payload modification done before every transmission, applied in given order:
+ *  {type: "counter", byte, shift = 0, bits = 8, start = 0, step = 1}
+ *  {type: "crc8", byte, from = 0, to = last, polynomial = 0x1D, init = 0xFF, xorOut = 0xFF}
+ * Bytes written or read by mutators have to be within payload of frame. Only data and remote
+ * request frames are accepted. Returns id of registered frame or -1 on error (WriteError is set).
+ * Registered frames are dropped on close().
+ */
+int IcsNeoCanBackend::addPeriodicFrame(const QCanBusFrame &frame, int periodUs, int count, const QVariantList &mutators)
+{
+    Q_D(IcsNeoCanBackend);
+
+    if (Q_UNLIKELY(state() != QCanBusDevice::ConnectedState))
+        return -1;
+
+    if (Q_UNLIKELY(!frame.isValid() || periodUs <= 0)) {
+        setError(tr("Cannot schedule invalid QCanBusFrame or period"), QCanBusDevice::WriteError);
+        return -1;
+    }
+    const QCanBusFrame::FrameType type = frame.frameType();
+    if (Q_UNLIKELY(type != QCanBusFrame::DataFrame && type != QCanBusFrame::RemoteRequestFrame)) {
+        setError(tr("Unable to write a frame with unacceptable type"),
+                 QCanBusDevice::WriteError);
+        return -1;
+    }
+
+    QVector<IcsNeoTransmitScheduler::PayloadMutator> payloadMutators;
+    for (const QVariant &spec : mutators) {
+        QString error;
+        IcsNeoTransmitScheduler::PayloadMutator mutator =
+                IcsNeoTransmitScheduler::createMutator(spec.toMap(), frame.payload().size(), &error);
+        if (!mutator) {
+            setError(error, QCanBusDevice::WriteError);
+            return -1;
+        }
+        payloadMutators.append(mutator);
+    }
+
+    if (!d->m_scheduler) {
+        d->m_scheduler = new IcsNeoTransmitScheduler(d, std::chrono::microseconds(d->m_schedulerSpin));
+        d->m_scheduler->start(QThread::TimeCriticalPriority);
+    }
+    return d->m_scheduler->add(frame, std::chrono::microseconds(periodUs), count, payloadMutators);
+}
+
+bool IcsNeoCanBackend::removePeriodicFrame(int id)
+{
+    Q_D(IcsNeoCanBackend);
+    return d->m_scheduler && d->m_scheduler->remove(id);
+}
+
+/** Returns sent frames count and transmit jitter in microseconds of periodic frame */
+QVariantMap IcsNeoCanBackend::periodicFrameStatistics(int id) const
+{
+    Q_D(const IcsNeoCanBackend);
+    IcsNeoTransmitScheduler::Statistics stats;
+    if (!d->m_scheduler || !d->m_scheduler->statistics(id, &stats))
+        return QVariantMap();
+
+    return QVariantMap {
+        { QStringLiteral("sent"),       stats.sent },
+        { QStringLiteral("failed"),     stats.failed },
+        { QStringLiteral("lastJitter"), stats.lastJitter / 1000.0 },
+        { QStringLiteral("minJitter"),  stats.minJitter / 1000.0 },
+        { QStringLiteral("maxJitter"),  stats.maxJitter / 1000.0 },
+        { QStringLiteral("meanJitter"), stats.meanJitter / 1000.0 }
+    };
+}
+
+// Counters of channel since open() - see IcsNeoChannelStatistics
+QVariantMap IcsNeoCanBackend::statistics() const
+{
+    return d_ptr->statistics();
+}
+
+QVariantMap IcsNeoCanBackend::readAllFramesWithChannels()
+{
+    Q_D(IcsNeoCanBackend);
+    return d->readAllFramesWithChannels();
+}
+
+/**
+ * Opens this backend together with given backends. Channels of the same physical device
+ * share single settings transaction, so their configuration is written to device once.
+ */
+bool IcsNeoCanBackend::openGroup(const QObjectList &backends)
+{
+    QVector<IcsNeoCanBackend *> group { this };
+    for (QObject *object : backends)
+    {
+        IcsNeoCanBackend *backend = qobject_cast<IcsNeoCanBackend *>(object);
+        if (backend && !group.contains(backend))
+            group.append(backend);
+    }
+    return IcsNeoCanBackendPrivate::openGroup(group);
+}
+
 void IcsNeoCanBackend::resetController()
 {
     Q_D(IcsNeoCanBackend);
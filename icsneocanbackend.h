@@ -40,6 +40,22 @@ public:
     void setConfigurationParameter(int key, const QVariant &value) override;
     bool writeFrame(const QCanBusFrame &newData) override;
 
+    // Opens this and given backends with one settings transaction per physical device
+    Q_INVOKABLE bool openGroup(const QObjectList &backends);
+
+    // Periodic transmit - accessible through QMetaObject::invokeMethod()
+    Q_INVOKABLE int addPeriodicFrame(const QCanBusFrame &frame, int periodUs, int count = 0,
+                                     const QVariantList &mutators = QVariantList());
+    Q_INVOKABLE bool removePeriodicFrame(int id);
+    Q_INVOKABLE QVariantMap periodicFrameStatistics(int id) const;
+
+    // Runtime counters of channel - accessible through QMetaObject::invokeMethod()
+    Q_INVOKABLE QVariantMap statistics() const;
+
+    // Frames with channel number each was received on ("frames" and "channels" entries) -
+    // tells apart frames of aggregate interface canX.* or canX.Y,Z
+    Q_INVOKABLE QVariantMap readAllFramesWithChannels();
+
 private:
     void resetController();
     QCanBusDevice::CanBusStatus busStatus();
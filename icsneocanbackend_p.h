@@ -6,9 +6,20 @@
 #define ICSNEOCANBACKEND_P_H
 
 #include "icsneocanbackend.h"
+#include "icsneopayloadpool.h"
+#include "icsneostatistics.h"
+#include "icsneotimesync.h"
+#include "icsneotransmitworker.h"
 #include "icsneo/icsneocpp.h"
+#include <atomic>
 #include <memory>
 
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qreadwritelock.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qwaitcondition.h>
+
 #if defined(Q_OS_WIN32)
 #  include <qt_windows.h>
 #endif
@@ -21,12 +32,18 @@ class QSocketNotifier;
 class QWinEventNotifier;
 class QTimer;
 class IcsNeoCanBackendPrivate;
+class IcsNeoFrameFilter;
+class IcsNeoCaptureWriter;
+class IcsNeoTransmitScheduler;
+class IcsNeoDeviceSupervisor;
+class IcsNeoVirtualDevice;
 
 namespace icsneo
 {
   class Device;
   class CANMessage;
   class Message;
+  class APIEvent;
 }
 
 
@@ -35,13 +52,15 @@ namespace icsneo
  * @TODO
  * Verify channel distinguish when starting or multiplexing particular device
  * Verification of bitrate according to icsnoe enum types
- * Probably incoming event handler is not needed
  * Posibly outcoming either - this could simplify interface
  * Implement all configuration / parameters Keys with its proper support during opening device
  * Verify if device status could be better implemnted
- * implement resetDevice properly
  */
 
+/**
+ * Periodically hands over received frames which are still waiting in the receive batch,
+ * so the batch latency is bounded even when the bus goes quiet.
+ */
 class IncomingEventHandler : public QObject
 {
     // no Q_OBJECT macro!
@@ -50,11 +69,82 @@ public:
         QObject(parent),
         dptr(systecPrivate) { }
 
+protected:
+    void timerEvent(QTimerEvent *e) override;
+
 private:
        IcsNeoCanBackendPrivate * const dptr;
 };
 
 
+/**
+ * Registers single message callback per physical device and routes each message
+ * by its NetID to the channel backend subscribed for it.
+ */
+class IcsNeoDeviceDispatcher
+{
+public:
+    explicit IcsNeoDeviceDispatcher(const std::shared_ptr<icsneo::Device> &device);
+    ~IcsNeoDeviceDispatcher();
+
+    static std::shared_ptr<IcsNeoDeviceDispatcher> forDevice(const std::shared_ptr<icsneo::Device> &device);
+
+    void subscribe(icsneo::Network::NetID netId, IcsNeoCanBackendPrivate *backend);
+    void unsubscribe(icsneo::Network::NetID netId, IcsNeoCanBackendPrivate *backend);
+    bool isSubscribed(icsneo::Network::NetID netId);
+
+    // Polling mode is common for all channels of device - it is active while any channel requests it
+    bool acquirePolling();
+    void releasePolling();
+    bool poll();
+
+    const IcsNeoClockCorrelator &clock() const { return m_clock; }
+
+    // Reconnect supervisor is common for all channels of device - it runs while any channel requests it
+    void acquireSupervision();
+    void releaseSupervision();
+    bool supervisorStatistics(quint64 *recoveries, qint64 *downtime);
+
+    // Transmit thread is common for all channels of device - it runs while any channel is attached
+    IcsNeoTransmitWorker::Channel *acquireTransmitWorker(IcsNeoCanBackendPrivate *backend, size_t capacity, int burst);
+    void releaseTransmitWorker(IcsNeoTransmitWorker::Channel *channel);
+    IcsNeoTransmitWorker *transmitWorker() const { return m_transmitWorker; }
+
+    // Closes and opens device again for all its channels - used by supervisor thread and resetController()
+    bool reopen(bool reapplySettings);
+
+    // Used by supervisor thread
+    bool anyBusOff();
+    bool restoreSettings();
+    void reattach();
+    void recovered();
+
+private:
+    void dispatch(const std::shared_ptr<icsneo::Message> &message);
+
+    std::shared_ptr<icsneo::Device> m_device;
+    int m_callbackId = 0;
+    QReadWriteLock m_routesGuard;
+    QVector<IcsNeoCanBackendPrivate *> m_routes; // indexed by NetID
+    IcsNeoClockCorrelator m_clock;               // updated by dispatching thread only
+
+    int m_pollingChannels = 0;
+    QMutex m_pollGuard;
+    std::vector<std::shared_ptr<icsneo::Message>> m_polledMessages;
+
+    QMutex m_supervisionGuard;
+    int m_supervisedChannels = 0;
+    IcsNeoDeviceSupervisor *m_supervisor = nullptr;
+
+    QMutex m_transmitGuard;
+    int m_transmitChannels = 0;
+    IcsNeoTransmitWorker *m_transmitWorker = nullptr;
+
+    static QMap<icsneo::Device *, std::weak_ptr<IcsNeoDeviceDispatcher>> m_dispatchers;
+    static QMutex m_dispatchersGuard;   // channels of different devices are opened and closed from any thread
+};
+
+
 class IcsNeoCanBackendPrivate
 {
     Q_DECLARE_PUBLIC(IcsNeoCanBackend)
@@ -62,23 +152,87 @@ class IcsNeoCanBackendPrivate
 public:
     IcsNeoCanBackendPrivate(IcsNeoCanBackend *q);
 
+    // Channel configuration as requested by keys or as last applied to device
+    struct ChannelSettings
+    {
+        QVariant loopback;
+        QVariant bitRate;
+        QVariant canFd;
+        QVariant iso;
+        QVariant dataBitRate;
+        QVariant termination;
+
+        bool operator==(const ChannelSettings &other) const
+        {
+            return loopback == other.loopback && bitRate == other.bitRate && canFd == other.canFd &&
+                   iso == other.iso && dataBitRate == other.dataBitRate && termination == other.termination;
+        }
+    };
+
     bool setupDevice();
+    bool settingsUpToDate() const;
+    bool stageSettings(const ChannelSettings &settings);
+    bool stageSettings(const ChannelSettings &settings, const icsneo::Network &network);
+    void commitSettings(bool applied);
+    static bool openGroup(const QVector<IcsNeoCanBackend *> &backends);
+    ChannelSettings requestedSettings() const;
+    QString settingsKey(const icsneo::Network &network) const;
+    bool cachedSettings(ChannelSettings *settings) const;
     bool open();
+    bool openVirtualDevice();
+    IcsNeoVirtualDevice *createVirtualDevice() const;
     void close();
     bool setConfigurationParameter(int key, const QVariant &value);
+    static bool parseInterfaceName(const QString &interfaceName, QString *kind, quint8 *deviceNumber,
+                                   QVector<quint8> *channels);
     bool setupChannel(const QString &interfaceName);
     void setupDefaultConfigurations();
+    void setupDeviceConfigurations();
+    void cacheDeviceSettings();
+    bool readDeviceSettings(const icsneo::Network &network, ChannelSettings *settings) const;
     void enableWriteNotification(bool enable);
     void startWrite();
+    std::shared_ptr<icsneo::CANMessage> createMessage(const QCanBusFrame &frame) const;
+    int transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages);
+    static QString writeErrorString(int failed, int total);
+    void reportFramesWritten(qint64 count);
+    void reportWriteError(int failed, int total);
     void readAllReceivedMessages();
+    void stageReceivedFrame(const QCanBusFrame &frame, int networkIndex);
+    bool reserveReceiveSpace(QMutexLocker &locker);
+    void spillOverflow(QVector<QCanBusFrame> &frames);
+    void resizeOverflow();
+    void flushReceivedFrames();
+    QByteArray takeQueuedTags(int count);
+    void enableReceiveNotification(bool enable);
+    QVariantMap readAllFramesWithChannels();
 
     void resetController();
+    bool restartNetwork();
+    bool reopenSession();
+    bool applyFactoryDefaults();
     QCanBusDevice::CanBusStatus busStatus();
+    void eventCallback(const std::shared_ptr<icsneo::APIEvent> &event);
+    void clearBusError();
+    QVariantMap statistics();
 
     static void interfaces( QList<QCanBusDeviceInfo> & list);
+    static std::shared_ptr<icsneo::Device> deviceFor(const QString &interfaceName);
+    static bool isVirtualInterface(const QString &interfaceName);
+    static bool isAggregateInterface(const QString &interfaceName);
+    static void refreshDevices();
+    static void refreshInBackground();
+    struct DiscoveredDevice;
+    static void updateDiscovered(const QVector<DiscoveredDevice> &probed);
+    static void watchHotplug();
 
-    void messageCallback(std::shared_ptr<icsneo::Message> m);
-    QCanBusFrame interpretFrame( icsneo::CANMessage * msg );
+    void messageCallback(const icsneo::CANMessage &msg);
+    void errorCountCallback(const icsneo::Network &network, quint8 transmitErrors, quint8 receiveErrors,
+                            bool busOff, quint64 timestamp);
+    int networkIndex(const icsneo::Network &network) const;
+    void resetErrorState();
+    QCanBusFrame interpretFrame(const icsneo::CANMessage &msg);
+    static QCanBusFrame::TimeStamp timeStampFromNanoseconds(qint64 ns);
 
     /*--------------*/
     IcsNeoCanBackend * const q_ptr;
@@ -87,12 +241,135 @@ public:
 
     quint8 device = 255;
     quint8 channel = 255;
+    QString m_interfaceName;
 
     std::shared_ptr<icsneo::Device> m_device;
     static QMap<QString, std::shared_ptr<icsneo::Device>> m_devices;
+
+    // Discovery cache - position in m_discovered is device number, so it stays stable across refreshes.
+    // Device is described once when probed, cache is rebuilt without calling into libicsneo.
+    struct DiscoveredDevice
+    {
+        QString serial;
+        QString description;
+        int channels;                           // number of CAN networks
+        std::shared_ptr<icsneo::Device> device; // nullptr when unplugged
+    };
+    static QVector<DiscoveredDevice> m_discovered;
+    static QList<QCanBusDeviceInfo> m_interfaces;
+    static QAtomicInt m_refreshQueued;
+    static QElapsedTimer m_discoveryAge;
+    static QMutex m_discoveryGuard;     // held while cache is read or updated, never while probing
+    static QMutex m_refreshGuard;       // serializes probing of devices
+
+    // Settings known to be in device - per network, keyed by settingsKey(). Session guard serializes channels of
+    // one device only, m_settingsGuard protects tables shared by all devices.
+    static QHash<QString, ChannelSettings> m_settingsCache;
+    // Number of opened channels per device
+    static int openChannels(icsneo::Device *device);
+    static QHash<icsneo::Device *, int> m_openChannels;
+    static QMutex m_settingsGuard;
+    // Serializes session operations on device (open, close, settings transaction, reset, recovery)
+    // between application and supervisor threads
+    static QRecursiveMutex *sessionGuard(icsneo::Device *device);
+    static QHash<icsneo::Device *, QRecursiveMutex *> m_sessionGuards;
+    static QMutex m_sessionGuardsGuard;
+    bool m_channelOpen = false;
+    bool m_appliedByGroup = false;      // openGroup() applied settings of channel just before its open()
+    ChannelSettings m_activeSettings;   // settings channel was opened with - restored by supervisor
+    std::shared_ptr<IcsNeoDeviceDispatcher> m_dispatcher;
+    std::atomic<int> m_dispatching {0};    // messages being handled from dispatcher without route lock
     icsneo::Network m_network; //  = icsneo::Network::NetID::Invalid;
 
-    int m_messageCallbackId = 0;
+    // Networks of aggregate interface (canX.* or canX.Y,Z) - single channel interface has just m_network.
+    // Received frames of aggregate interface are tagged with channel number of their network, tags are
+    // kept in the same order as frames queued in QCanBusDevice.
+    static constexpr int MaxAggregatedNetworks = 16;
+    QVector<icsneo::Network> m_networks;
+    QVector<quint8> m_networkChannels;  // channel number of each network
+    QVector<qint8> m_networkIndexes;    // position in m_networks indexed by NetID, -1 when not aggregated
+    QByteArray m_incomingTags;          // tags of m_incomingFrames
+    QByteArray m_queuedTags;            // tags of frames handed over to QCanBusDevice
+    int m_queuedTagsBegin = 0;          // tags in front of it belong to frames already read
+    std::shared_ptr<const IcsNeoFrameFilter> m_frameFilter; // RawFilterKey - nullptr accepts all frames
+
+    // Receive batch - filled from libicsneo callback thread, flushed by batch size or latency.
+    // Hand-over state is guarded by m_incomingGuard, which is released while frames are enqueued.
+    QMutex m_incomingGuard;
+    QThread *m_handOverThread = nullptr;    // thread handing frames over to QCanBusDevice
+    bool m_handOverInFlight = false;        // tags of batch are queued, its frames are being enqueued
+    bool m_flushRequested = false;          // staged frames are to be handed over after current batch
+    QWaitCondition m_handOverDone;
+    QVector<QCanBusFrame> m_incomingFrames;
+    QVector<QCanBusFrame> m_spareFrames;     // previous staging vector, possibly still shared with application
+    QElapsedTimer m_incomingAge;
+    IcsNeoPayloadPool m_payloadPool;    // used by receiving thread only
+    int m_receiveBatchSize = 128;
+    int m_receiveLatency = 5;   // [ms]
+    int m_receiveTimerId = 0;
+
+    // Bounded receive buffer
+    std::atomic<bool> m_receiving {false};
+    int m_receiveBufferSize = 0;    // 0 - unlimited
+    int m_receiveOverflowPolicy = 0;
+    std::atomic<quint64> m_droppedFrames {0};
+    QVector<QCanBusFrame> m_overflowFrames; // ReceiveOverflowDropOldest ring - frames QCanBusDevice has no room for
+    QByteArray m_overflowTags;
+    int m_overflowBegin = 0;
+    int m_overflowCount = 0;
+    quint64 m_reportedDroppedFrames = 0;
+
+    IcsNeoChannelStatistics m_statistics;
+
+    // Controller error state tracked from error counters reported by device
+    enum ErrorState { ErrorActive, ErrorWarning, ErrorPassive, ErrorBusOff };
+    std::atomic<int> m_errorState {ErrorActive};                       // worst state of all networks
+    std::atomic<int> m_networkErrorStates[MaxAggregatedNetworks] {};   // written by receiving thread only
+    std::atomic<int> m_errorFilter {QCanBusFrame::AnyError};   // ErrorFilterKey
+
+    // Bus state cached from libicsneo event callback - events are described only when reported
+    static constexpr size_t MaxPendingEvents = 16;
+    int m_eventCallbackId = -1;
+    std::atomic<bool> m_busError {false};
+    std::atomic<quint32> m_eventGeneration {0};
+    quint32 m_reportedEventGeneration = 0;
+    QMutex m_eventGuard;
+    std::vector<std::shared_ptr<icsneo::APIEvent>> m_pendingEvents;
+    quint32 m_skippedEvents = 0;
+
+    // Polling receive mode - 0 means libicsneo callback
+    int m_pollingInterval = 0;  // [ms]
+    int m_pollTimerId = 0;
+
+    std::atomic<int> m_timestampMode {0};   // TimestampDevice, read by callback thread
+    int m_resetMode = 0;     // ResetController
+    bool m_autoRecovery = false;
+    bool m_supervised = false;
+
+    // Capture of received frames into file - written from receiving thread
+    QString m_captureFile;
+    IcsNeoCaptureWriter *m_capture = nullptr;
+    bool m_captureFailureReported = false;
+
+    // Transmit burst - frames dequeued and transmitted at single write notification
+    std::vector<std::shared_ptr<icsneo::Message>> m_outgoingMessages;
+    int m_transmitBurst = 64;
+
+    // Optional dedicated transmit thread fed by lock-free ring
+    IcsNeoTransmitWorker *m_transmitWorker = nullptr;            // shared by dispatcher or owned by virtual device channel
+    IcsNeoTransmitWorker::Channel *m_transmitChannel = nullptr;
+    int m_transmitThreadCapacity = 0;
+
+    // Virtual device - stands in for m_device of interfaces without hardware
+    QString m_virtualKind;  // interface prefix, empty for hardware channels
+    IcsNeoVirtualDevice *m_virtualDevice = nullptr;
+    QString m_replayFile;
+    double m_replaySpeed = 1.0;
+
+    // Periodic transmit - created on first registered frame
+    IcsNeoTransmitScheduler *m_scheduler = nullptr;
+    int m_schedulerSpin = 20;   // [us]
+
     bool m_hasFD = false;
     bool m_hasIso = false;
     bool m_hasTermination = false;
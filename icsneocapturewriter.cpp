@@ -0,0 +1,200 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneocapturewriter.h"
+
+#include <QtCore/qendian.h>
+
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+// pcapng block types
+static const quint32 SectionHeaderBlock       = 0x0A0D0D0A;
+static const quint32 InterfaceDescriptionBlock = 0x00000001;
+static const quint32 EnhancedPacketBlock      = 0x00000006;
+static const quint32 ByteOrderMagic           = 0x1A2B3C4D;
+static const quint16 LinkTypeCanSocketCan     = 227;
+// pcapng options
+static const quint16 OptionEnd                = 0;
+static const quint16 OptionInterfaceName      = 2;
+static const quint16 OptionTimestampResolution = 9;
+
+static inline quint32 padded(quint32 size)
+{
+    return (size + 3U) & ~3U;
+}
+
+IcsNeoCaptureWriter::IcsNeoCaptureWriter(const QString &fileName, const QStringList &interfaceNames) :
+    m_file(fileName),
+    m_interfaceNames(interfaceNames)
+{
+    m_active.reserve(BlockSize + 128);
+    m_pending.reserve(BlockSize + 128);
+}
+
+IcsNeoCaptureWriter::~IcsNeoCaptureWriter()
+{
+    close();
+}
+
+bool IcsNeoCaptureWriter::open(QString *errorMessage)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        *errorMessage = m_file.errorString();
+        return false;
+    }
+
+    m_stop = false;
+    m_failed.store(false, std::memory_order_relaxed);
+    m_droppedFrames.store(0, std::memory_order_relaxed);
+    appendHeader();
+    start();
+    return true;
+}
+
+void IcsNeoCaptureWriter::close()
+{
+    if (!m_file.isOpen())
+        return;
+
+    {
+        QMutexLocker locker(&m_guard);
+        m_stop = true;
+        m_ready.wakeOne();
+    }
+    wait();
+
+    if (!hasFailed())
+        writeBlock(m_active);
+    m_active.clear();
+    m_file.close();
+}
+
+QString IcsNeoCaptureWriter::errorString() const
+{
+    QMutexLocker locker(&m_guard);
+    return m_error;
+}
+
+// Called without m_guard by writer thread, or after it finished
+void IcsNeoCaptureWriter::writeBlock(const std::vector<char> &block)
+{
+    if (m_file.write(block.data(), qint64(block.size())) == qint64(block.size()))
+        return;
+
+    QMutexLocker locker(&m_guard);
+    m_error = m_file.errorString();
+    m_failed.store(true, std::memory_order_release);
+}
+
+// Called from receiving thread
+void IcsNeoCaptureWriter::write(quint32 interfaceId, quint64 timestampNs, quint32 canId, const quint8 *data, int size,
+                                bool fd, quint8 fdFlags)
+{
+    // struct can_frame / canfd_frame - can_id is big endian for LINKTYPE_CAN_SOCKETCAN
+    const quint32 dataSize = fd ? 64 : 8;
+    const quint32 packetSize = 8 + dataSize;
+    const quint32 blockSize = 28 + packetSize + 4;
+    const int length = qMin(size, int(dataSize));
+
+    QMutexLocker locker(&m_guard);
+
+    if (Q_UNLIKELY(m_failed.load(std::memory_order_relaxed) || m_active.size() >= MaxActiveSize))
+    {
+        m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    append(EnhancedPacketBlock);
+    append(blockSize);
+    append(interfaceId);
+    append(quint32(timestampNs >> 32));
+    append(quint32(timestampNs & 0xFFFFFFFFU));
+    append(packetSize);                          // captured length
+    append(packetSize);                          // original length
+    append(qToBigEndian(canId));
+    append(quint8(length));
+    append(quint8(fd ? (fdFlags | FlexibleDataFlag) : 0));
+    append(quint16(0));                          // reserved
+    const size_t offset = m_active.size();
+    m_active.resize(offset + dataSize, 0);
+    if (length > 0)
+        std::memcpy(m_active.data() + offset, data, size_t(length));
+    append(blockSize);
+
+    if (m_active.size() >= BlockSize && m_pending.empty())
+    {
+        m_active.swap(m_pending);
+        m_ready.wakeOne();
+    }
+}
+
+void IcsNeoCaptureWriter::run()
+{
+    QMutexLocker locker(&m_guard);
+    while (true)
+    {
+        while (m_pending.empty() && !m_stop)
+            m_ready.wait(&m_guard);
+        if (m_pending.empty())
+            break;
+
+        // Receiving thread does not touch pending block till it is empty
+        locker.unlock();
+        if (!hasFailed())
+            writeBlock(m_pending);
+        locker.relock();
+        m_pending.clear();
+    }
+}
+
+void IcsNeoCaptureWriter::appendHeader()
+{
+    // Section Header Block
+    append(SectionHeaderBlock);
+    append(quint32(28));
+    append(ByteOrderMagic);
+    append(quint16(1));                 // major version
+    append(quint16(0));                 // minor version
+    append(qint64(-1));                 // section length not specified
+    append(quint32(28));
+
+    for (const QString &name : m_interfaceNames)
+        appendInterface(name);
+}
+
+// Interface Description Block with if_name and if_tsresol = 10^-9
+void IcsNeoCaptureWriter::appendInterface(const QString &interfaceName)
+{
+    const QByteArray name = interfaceName.toUtf8();
+    const quint32 nameSize = padded(quint32(name.size()));
+    const quint32 blockSize = 20 + (4 + nameSize) + (4 + 4) + 4;
+
+    append(InterfaceDescriptionBlock);
+    append(blockSize);
+    append(LinkTypeCanSocketCan);
+    append(quint16(0));                 // reserved
+    append(quint32(0));                 // snap length - no limit
+    append(OptionInterfaceName);
+    append(quint16(name.size()));
+    append(name.constData(), size_t(name.size()));
+    m_active.resize(m_active.size() + (nameSize - quint32(name.size())), 0);
+    append(OptionTimestampResolution);
+    append(quint16(1));
+    append(quint8(9));
+    m_active.resize(m_active.size() + 3, 0);
+    append(OptionEnd);
+    append(quint16(0));
+    append(blockSize);
+}
+
+void IcsNeoCaptureWriter::append(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    m_active.insert(m_active.end(), bytes, bytes + size);
+}
+
+QT_END_NAMESPACE
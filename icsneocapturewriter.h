@@ -0,0 +1,82 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOCAPTUREWRITER_H
+#define ICSNEOCAPTUREWRITER_H
+
+#include <QtCore/qfile.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qwaitcondition.h>
+
+#include <atomic>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Writes received frames into pcapng file (LINKTYPE_CAN_SOCKETCAN, nanosecond timestamps).
+ * Each network of captured interface has its own pcapng interface, numbered in given order.
+ * Frames are encoded by calling thread into active block, full block is swapped with
+ * spare one and written to disk by own thread. Frames which do not fit while disk lags
+ * behind, or come after write error, are dropped and counted.
+ */
+class IcsNeoCaptureWriter : public QThread
+{
+    // no Q_OBJECT macro!
+public:
+    // SocketCAN can_id flags
+    static constexpr quint32 ExtendedFlag = 0x80000000U;
+    static constexpr quint32 RemoteFlag   = 0x40000000U;
+    static constexpr quint32 ErrorFlag    = 0x20000000U;
+    // SocketCAN canfd_frame flags
+    static constexpr quint8 BitrateSwitchFlag  = 0x01;
+    static constexpr quint8 ErrorStateFlag     = 0x02;
+    static constexpr quint8 FlexibleDataFlag   = 0x04;
+
+    IcsNeoCaptureWriter(const QString &fileName, const QStringList &interfaceNames);
+    ~IcsNeoCaptureWriter() override;
+
+    bool open(QString *errorMessage);
+    void close();
+
+    void write(quint32 interfaceId, quint64 timestampNs, quint32 canId, const quint8 *data, int size, bool fd,
+               quint8 fdFlags);
+
+    quint64 droppedFrames() const { return m_droppedFrames.load(std::memory_order_relaxed); }
+    bool hasFailed() const { return m_failed.load(std::memory_order_acquire); }
+    QString errorString() const;    // valid when hasFailed()
+
+protected:
+    void run() override;
+
+private:
+    static constexpr size_t BlockSize = 1 << 20;
+    static constexpr size_t MaxActiveSize = 4 * BlockSize;  // active block limit while spare one is written
+
+    void writeBlock(const std::vector<char> &block);
+
+    void appendHeader();
+    void appendInterface(const QString &name);
+    void append(const void *data, size_t size);
+    template <typename T> void append(T value) { append(&value, sizeof(T)); }
+
+    QFile m_file;
+    const QStringList m_interfaceNames;
+
+    mutable QMutex m_guard;
+    QWaitCondition m_ready;
+    std::vector<char> m_active;     // filled by receiving thread
+    std::vector<char> m_pending;    // written by writer thread
+    bool m_stop = false;
+
+    std::atomic<quint64> m_droppedFrames {0};
+    std::atomic<bool> m_failed {false};
+    QString m_error;                // guarded by m_guard
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOCAPTUREWRITER_H
@@ -0,0 +1,104 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneoframefilter.h"
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+IcsNeoFrameFilter::IcsNeoFrameFilter(const QList<QCanBusDevice::Filter> &filters)
+{
+    std::vector<Range> ranges;
+
+    for (const QCanBusDevice::Filter &filter : filters)
+    {
+        const quint8 types = typesOf(filter.type);
+
+        if (int(filter.format) & QCanBusDevice::Filter::MatchBaseFormat)
+        {
+            const quint32 mask = filter.frameIdMask & (BaseIdCount - 1);
+            const quint32 id = filter.frameId & mask;
+            for (quint32 frameId = 0; frameId < BaseIdCount; ++frameId)
+            {
+                if ((frameId & mask) != id)
+                    continue;
+                for (int bit = 0; bit < 3; ++bit)
+                    if (types & (1 << bit))
+                        m_base[bit].set(frameId);
+            }
+        }
+
+        if (int(filter.format) & QCanBusDevice::Filter::MatchExtendedFormat)
+        {
+            const quint32 mask = filter.frameIdMask & ExtendedIdMask;
+            const quint32 id = filter.frameId & mask;
+            const quint32 wildcard = ~mask & ExtendedIdMask;
+
+            // Exact or prefix mask (wildcard bits only at the bottom) is continuous range of identifiers
+            if ((wildcard & (wildcard + 1)) == 0)
+                ranges.push_back({ id, id | wildcard, types });
+            else
+                m_masks.push_back({ id, mask, types });
+        }
+    }
+
+    // Split overlapping ranges into disjoint ones, so lookup is single binary search
+    std::vector<quint64> bounds;
+    for (const Range &range : ranges)
+    {
+        bounds.push_back(range.first);
+        bounds.push_back(quint64(range.last) + 1);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    for (size_t i = 0; i + 1 < bounds.size(); ++i)
+    {
+        const quint32 first = quint32(bounds[i]);
+        const quint32 last = quint32(bounds[i + 1] - 1);
+        quint8 types = 0;
+        for (const Range &range : ranges)
+            if (range.first <= first && last <= range.last)
+                types |= range.types;
+        if (!types)
+            continue;
+
+        if (!m_ranges.empty() && m_ranges.back().types == types && m_ranges.back().last + 1 == first)
+            m_ranges.back().last = last;
+        else
+            m_ranges.push_back({ first, last, types });
+    }
+}
+
+quint8 IcsNeoFrameFilter::typesOf(QCanBusFrame::FrameType type)
+{
+    switch (type)
+    {
+    case QCanBusFrame::DataFrame:           return DataBit;
+    case QCanBusFrame::RemoteRequestFrame:  return RemoteBit;
+    case QCanBusFrame::ErrorFrame:          return ErrorBit;
+    default:                                return DataBit | RemoteBit | ErrorBit; // InvalidFrame matches all
+    }
+}
+
+bool IcsNeoFrameFilter::acceptsExtended(quint32 frameId, quint8 typeBit) const
+{
+    auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), frameId,
+                               [](quint32 id, const Range &range) { return id < range.first; });
+    if (it != m_ranges.begin())
+    {
+        --it;
+        if (frameId <= it->last && (it->types & typeBit))
+            return true;
+    }
+
+    for (const Mask &mask : m_masks)
+        if ((frameId & mask.mask) == mask.id && (mask.types & typeBit))
+            return true;
+
+    return false;
+}
+
+QT_END_NAMESPACE
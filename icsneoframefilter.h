@@ -0,0 +1,69 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOFRAMEFILTER_H
+#define ICSNEOFRAMEFILTER_H
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <bitset>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Compiled form of QCanBusDevice::RawFilterKey evaluated before frame is constructed.
+ * 11-bit identifiers are looked up in bitmaps, 29-bit identifiers in sorted table of
+ * disjoint ranges (exact and prefix masks) followed by remaining arbitrary masks.
+ */
+class IcsNeoFrameFilter
+{
+public:
+    enum TypeBit : quint8
+    {
+        DataBit   = 0x01,
+        RemoteBit = 0x02,
+        ErrorBit  = 0x04
+    };
+
+    explicit IcsNeoFrameFilter(const QList<QCanBusDevice::Filter> &filters);
+
+    inline bool accepts(quint32 frameId, bool extended, quint8 typeBit) const
+    {
+        if (!extended)
+            return frameId < BaseIdCount && m_base[bitIndex(typeBit)].test(frameId);
+        return acceptsExtended(frameId, typeBit);
+    }
+
+private:
+    static constexpr quint32 BaseIdCount = 0x800;
+    static constexpr quint32 ExtendedIdMask = 0x1FFFFFFF;
+
+    struct Range
+    {
+        quint32 first;
+        quint32 last;
+        quint8 types;
+    };
+
+    struct Mask
+    {
+        quint32 id;
+        quint32 mask;
+        quint8 types;
+    };
+
+    static int bitIndex(quint8 typeBit) { return typeBit == DataBit ? 0 : (typeBit == RemoteBit ? 1 : 2); }
+    static quint8 typesOf(QCanBusFrame::FrameType type);
+    bool acceptsExtended(quint32 frameId, quint8 typeBit) const;
+
+    std::bitset<BaseIdCount> m_base[3]; // data, remote, error
+    std::vector<Range> m_ranges;        // sorted, disjoint
+    std::vector<Mask> m_masks;
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOFRAMEFILTER_H
@@ -0,0 +1,265 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneomergebackend.h"
+#include "icsneocanbackend.h"
+#include "icsneotimesync.h"
+#include "include/qticsneo_keys.h"
+
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+
+IcsNeoMergeBackend::IcsNeoMergeBackend(const QString &name, QObject *parent) :
+    QCanBusDevice(parent),
+    m_flushTimer(new QTimer(this))
+{
+    const QStringList names = name.mid(name.indexOf(QLatin1Char(':')) + 1)
+                                  .split(QLatin1Char(';'), Qt::SkipEmptyParts);
+    for (const QString &sourceName : names)
+    {
+        const int index = int(m_sources.size());
+        IcsNeoCanBackend *backend = new IcsNeoCanBackend(sourceName.trimmed(), this);
+        m_hostTimebase &= sourceName.trimmed().startsWith(QLatin1String("can"));
+
+        connect(backend, &QCanBusDevice::framesReceived, this, [this, index]() { receive(index); });
+        connect(backend, &QCanBusDevice::errorOccurred, this,
+                [this, backend](QCanBusDevice::CanBusError error) { setError(backend->errorString(), error); });
+
+        Source source;
+        source.backend = backend;
+        m_sources.push_back(std::move(source));
+    }
+    if (!m_sources.empty())
+        connect(m_sources.front().backend, &QCanBusDevice::framesWritten, this, &QCanBusDevice::framesWritten);
+
+    m_flushTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_flushTimer, &QTimer::timeout, this, [this]() { merge(); });
+
+    QCanBusDevice::setConfigurationParameter(ParameterMergeWindowKey, m_window);
+    std::function<CanBusStatus()> g = std::bind(&IcsNeoMergeBackend::busStatus, this);
+    setCanBusStatusGetter(g);
+}
+
+IcsNeoMergeBackend::~IcsNeoMergeBackend()
+{
+    if (state() == QCanBusDevice::ConnectedState)
+        close();
+}
+
+bool IcsNeoMergeBackend::isMergeInterface(const QString &name)
+{
+    return name.startsWith(QLatin1String("merge:"));
+}
+
+QString IcsNeoMergeBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
+{
+    return m_sources.empty() ? QString() : m_sources.front().backend->interpretErrorFrame(errorFrame);
+}
+
+bool IcsNeoMergeBackend::open()
+{
+    if (m_sources.empty())
+    {
+        setError(tr("Merged interface has no source interfaces"), QCanBusDevice::ConnectionError);
+        return false;
+    }
+
+    // Sources are configured by keys of merged interface, their timestamps have to share host clock
+    const QVector<int> keys = configurationKeys();
+    QObjectList others;
+    for (const Source &source : m_sources)
+    {
+        for (int key : keys)
+            if (key != ParameterMergeWindowKey)
+                source.backend->setConfigurationParameter(key, configurationParameter(key));
+        if (m_hostTimebase)
+            source.backend->setConfigurationParameter(ParameterTimestampModeKey, TimestampHost);
+        if (source.backend != m_sources.front().backend)
+            others.append(source.backend);
+    }
+
+    for (Source &source : m_sources)
+        source.pending.clear();
+    m_heap.clear();
+    m_merged.clear();
+    m_newest = 0;
+    m_lastReleased = 0;
+    m_mergedFrames = 0;
+    m_lateFrames = 0;
+    m_sinceNewest.start();
+
+    // Channels of the same device are configured in single settings transaction
+    if (!m_sources.front().backend->openGroup(others))
+    {
+        for (const Source &source : m_sources)
+            if (source.backend->state() == QCanBusDevice::ConnectedState)
+                source.backend->disconnectDevice();
+        return false;   // error of failed source is already forwarded
+    }
+
+    m_flushTimer->start(qMax(1, m_window / 2));
+    setState(QCanBusDevice::ConnectedState);
+    return true;
+}
+
+void IcsNeoMergeBackend::close()
+{
+    setState(QCanBusDevice::ClosingState);
+    m_flushTimer->stop();
+    for (const Source &source : m_sources)
+        if (source.backend->state() == QCanBusDevice::ConnectedState)
+            source.backend->disconnectDevice();
+    setState(QCanBusDevice::UnconnectedState);
+}
+
+void IcsNeoMergeBackend::setConfigurationParameter(int key, const QVariant &value)
+{
+    if (key == ParameterMergeWindowKey)
+    {
+        bool ok = false;
+        const int window = value.toInt(&ok);
+        if (!ok || window < 0)
+        {
+            setError(tr("Merge window must be a non-negative number of milliseconds"),
+                     QCanBusDevice::ConfigurationError);
+            return;
+        }
+        m_window = window;
+        if (m_flushTimer->isActive())
+            m_flushTimer->start(qMax(1, m_window / 2));
+    }
+    else if (key == ParameterTimestampModeKey)
+    {
+        setError(tr("Timestamps of merged interface cannot be changed"), QCanBusDevice::ConfigurationError);
+        return;
+    }
+    else if (state() == QCanBusDevice::ConnectedState)
+    {
+        for (const Source &source : m_sources)
+            source.backend->setConfigurationParameter(key, value);
+    }
+    QCanBusDevice::setConfigurationParameter(key, value);
+}
+
+bool IcsNeoMergeBackend::writeFrame(const QCanBusFrame &newData)
+{
+    if (Q_UNLIKELY(state() != QCanBusDevice::ConnectedState))
+        return false;
+    return m_sources.front().backend->writeFrame(newData);
+}
+
+QVariantMap IcsNeoMergeBackend::statistics() const
+{
+    qint64 pending = 0;
+    QVariantList sources;
+    for (const Source &source : m_sources)
+    {
+        pending += qint64(source.pending.size());
+        sources.append(source.backend->statistics());
+    }
+
+    QVariantMap map;
+    map.insert(QStringLiteral("mergedFrames"), m_mergedFrames);
+    map.insert(QStringLiteral("lateFrames"), m_lateFrames);
+    map.insert(QStringLiteral("pendingFrames"), pending);
+    map.insert(QStringLiteral("window"), m_window);
+    map.insert(QStringLiteral("sources"), sources);
+    return map;
+}
+
+qint64 IcsNeoMergeBackend::timestampOf(const QCanBusFrame &frame)
+{
+    const QCanBusFrame::TimeStamp timeStamp = frame.timeStamp();
+    return timeStamp.seconds() * 1000000 + timeStamp.microSeconds();
+}
+
+void IcsNeoMergeBackend::receive(int index)
+{
+    Source &source = m_sources[size_t(index)];
+    if (source.backend->state() != QCanBusDevice::ConnectedState)
+        return;
+
+    const QVector<QCanBusFrame> frames = source.backend->readAllFrames();
+    if (frames.isEmpty())
+        return;
+
+    const bool wasEmpty = source.pending.empty();
+    source.pending.insert(source.pending.end(), frames.cbegin(), frames.cend());
+    if (wasEmpty)
+    {
+        m_heap.push_back({ timestampOf(source.pending.front()), index });
+        std::push_heap(m_heap.begin(), m_heap.end(), laterThan);
+    }
+
+    const qint64 newest = timestampOf(frames.last());
+    if (newest > m_newest)
+    {
+        m_newest = newest;
+        m_sinceNewest.start();
+    }
+    merge();
+}
+
+// Frames older than watermark are not expected to be preceded by frames still to come
+qint64 IcsNeoMergeBackend::watermark() const
+{
+    const qint64 window = qint64(m_window) * 1000;
+    if (m_hostTimebase)
+        return IcsNeoClockCorrelator::hostNow() / 1000 - window;
+
+    // Virtual sources have no common clock - time goes on from newest received frame
+    return m_newest + m_sinceNewest.elapsed() * 1000 - window;
+}
+
+// Releases source heads in timestamp order. Each source is in order, so the oldest head is the oldest
+// frame of all when every source has a frame waiting - otherwise it has to be older than watermark.
+void IcsNeoMergeBackend::merge()
+{
+    const qint64 limit = watermark();
+    while (!m_heap.empty())
+    {
+        const Head head = m_heap.front();
+        if (m_heap.size() < m_sources.size() && head.timestamp > limit)
+            break;
+
+        std::pop_heap(m_heap.begin(), m_heap.end(), laterThan);
+        m_heap.pop_back();
+
+        Source &source = m_sources[size_t(head.source)];
+        if (head.timestamp < m_lastReleased)
+            m_lateFrames++;
+        else
+            m_lastReleased = head.timestamp;
+        m_merged.append(std::move(source.pending.front()));
+        source.pending.pop_front();
+
+        if (!source.pending.empty())
+        {
+            m_heap.push_back({ timestampOf(source.pending.front()), head.source });
+            std::push_heap(m_heap.begin(), m_heap.end(), laterThan);
+        }
+    }
+
+    if (m_merged.isEmpty())
+        return;
+    m_mergedFrames += quint64(m_merged.size());
+    enqueueReceivedFrames(m_merged);
+    m_merged.clear();
+}
+
+// Worst state of sources - CanBusStatus values grow with severity. Public QCanBusDevice::busStatus()
+// of source is hidden by its private getter, so it is called through base class.
+QCanBusDevice::CanBusStatus IcsNeoMergeBackend::busStatus()
+{
+    CanBusStatus status = CanBusStatus::Unknown;
+    for (const Source &source : m_sources)
+        status = qMax(status, static_cast<QCanBusDevice *>(source.backend)->busStatus());
+    return status;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,90 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOMERGEBACKEND_H
+#define ICSNEOMERGEBACKEND_H
+
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusdevice.h>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qvector.h>
+
+#include <deque>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+class IcsNeoCanBackend;
+
+/**
+ * Merged interface merge:A;B;... - frames received by source interfaces A, B (e.g. can0.* and can1.*
+ * of different devices) are delivered as single stream ordered by timestamp.
+ * Sources of hardware devices use device clocks mapped onto host clock (TimestampHost), so their
+ * timestamps are comparable. Each source is already in order, so k-way merge of source heads
+ * needs heap of at most one entry per source. Head frame is released when every source has
+ * a frame waiting or when it is older than reorder window (ParameterMergeWindowKey).
+ */
+class IcsNeoMergeBackend : public QCanBusDevice
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(IcsNeoMergeBackend)
+public:
+    explicit IcsNeoMergeBackend(const QString &name, QObject *parent = nullptr);
+    ~IcsNeoMergeBackend();
+
+    static bool isMergeInterface(const QString &name);
+
+    QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
+
+    bool open() override;
+    void close() override;
+    void setConfigurationParameter(int key, const QVariant &value) override;
+    // Frames are transmitted by first source
+    bool writeFrame(const QCanBusFrame &newData) override;
+
+    // Merge counters and statistics() of each source - accessible through QMetaObject::invokeMethod()
+    Q_INVOKABLE QVariantMap statistics() const;
+
+private:
+    struct Source
+    {
+        IcsNeoCanBackend *backend = nullptr;
+        std::deque<QCanBusFrame> pending;
+    };
+
+    struct Head
+    {
+        qint64 timestamp;   // [us]
+        int source;
+    };
+
+    static qint64 timestampOf(const QCanBusFrame &frame);
+    static bool laterThan(const Head &a, const Head &b) { return a.timestamp > b.timestamp; }
+
+    void receive(int source);
+    void merge();
+    qint64 watermark() const;
+    QCanBusDevice::CanBusStatus busStatus();
+
+    std::vector<Source> m_sources;
+    std::vector<Head> m_heap;           // min-heap of source heads
+    QVector<QCanBusFrame> m_merged;
+    QTimer *m_flushTimer = nullptr;
+    bool m_hostTimebase = true;         // all sources report host correlated timestamps
+
+    int m_window = 10;  // [ms]
+    qint64 m_newest = 0;                // newest timestamp received from any source [us]
+    QElapsedTimer m_sinceNewest;
+    qint64 m_lastReleased = 0;          // [us]
+
+    quint64 m_mergedFrames = 0;
+    quint64 m_lateFrames = 0;           // frames arrived after newer frames were released
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOMERGEBACKEND_H
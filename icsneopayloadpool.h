@@ -0,0 +1,54 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOPAYLOADPOOL_H
+#define ICSNEOPAYLOADPOOL_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qvector.h>
+
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Recycles payload buffers of received frames. Buffers are handed out round robin and buffer
+ * is refilled in place only when it is detached - application released all frames sharing it.
+ * Buffer still in use is replaced by new allocation, so pool never blocks receiving.
+ * Used by single receiving thread.
+ */
+class IcsNeoPayloadPool
+{
+public:
+    static constexpr int Size = 1024;       // power of two
+    static constexpr int MinCapacity = 64;  // CAN-FD frame fits into any buffer
+
+    IcsNeoPayloadPool() : m_buffers(Size) { }
+
+    QByteArray acquire(const void *data, int size)
+    {
+        if (size == 0)
+            return QByteArray();
+
+        QByteArray &buffer = m_buffers[m_next];
+        m_next = (m_next + 1) & (Size - 1);
+
+        if (!buffer.isDetached() || buffer.capacity() < size)
+        {
+            buffer = QByteArray();
+            buffer.reserve(qMax(size, MinCapacity));
+        }
+        buffer.resize(size);    // stays within capacity
+        std::memcpy(buffer.data(), data, size_t(size));
+        return buffer;
+    }
+
+private:
+    QVector<QByteArray> m_buffers;
+    int m_next = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOPAYLOADPOOL_H
@@ -0,0 +1,249 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneoscheduler.h"
+#include "icsneocanbackend_p.h"
+
+#include <algorithm>
+#include <thread>
+
+QT_BEGIN_NAMESPACE
+
+IcsNeoTransmitScheduler::IcsNeoTransmitScheduler(IcsNeoCanBackendPrivate *d, std::chrono::nanoseconds spin) :
+    dptr(d),
+    m_spin(spin)
+{
+}
+
+IcsNeoTransmitScheduler::~IcsNeoTransmitScheduler()
+{
+    stop();
+}
+
+int IcsNeoTransmitScheduler::add(const QCanBusFrame &frame, std::chrono::nanoseconds period, qint64 count,
+                                 const QVector<PayloadMutator> &mutators)
+{
+    Entry entry;
+    entry.frame     = frame;
+    entry.payload   = frame.payload();
+    entry.period    = period;
+    entry.remaining = count > 0 ? count : -1;
+    entry.due       = Clock::now();
+    entry.mutators  = mutators;
+
+    int id = 0;
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        id = m_nextId++;
+        m_entries.emplace(id, std::move(entry));
+    }
+    m_changed.notify_one();
+    return id;
+}
+
+bool IcsNeoTransmitScheduler::remove(int id)
+{
+    bool removed = false;
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        removed = m_entries.erase(id) > 0;
+    }
+    m_changed.notify_one();
+    return removed;
+}
+
+bool IcsNeoTransmitScheduler::statistics(int id, Statistics *stats) const
+{
+    std::lock_guard<std::mutex> locker(m_guard);
+    const auto it = m_entries.find(id);
+    if (it == m_entries.end())
+        return false;
+    *stats = it->second.stats;
+    return true;
+}
+
+void IcsNeoTransmitScheduler::setSpin(std::chrono::nanoseconds spin)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        m_spin = spin;
+    }
+    m_changed.notify_one();
+}
+
+void IcsNeoTransmitScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        m_stop = true;
+    }
+    m_changed.notify_one();
+    wait();
+}
+
+void IcsNeoTransmitScheduler::run()
+{
+    std::unique_lock<std::mutex> locker(m_guard);
+    while (!m_stop)
+    {
+        Clock::time_point next = Clock::time_point::max();
+        for (const auto &it : m_entries)
+            if (it.second.remaining != 0)
+                next = std::min(next, it.second.due);
+
+        if (next == Clock::time_point::max())
+        {
+            m_changed.wait(locker);
+            continue;
+        }
+
+        // Thread sleeps till the final slice before deadline - only that slice is spun, as condition
+        // variable wakes up late by timer slack of the system
+        if (next - Clock::now() > m_spin)
+        {
+            m_changed.wait_until(locker, next - m_spin);
+            continue; // entries could have been changed meanwhile
+        }
+
+        if (Clock::now() < next)
+        {
+            locker.unlock();
+            while (Clock::now() < next)
+                std::this_thread::yield();
+            locker.lock();
+            continue;
+        }
+
+        const Clock::time_point now = Clock::now();
+        m_messages.clear();
+        m_pending.clear();
+        for (auto &it : m_entries)
+        {
+            Entry &entry = it.second;
+            if (entry.remaining == 0 || entry.due > now)
+                continue;
+
+            for (const PayloadMutator &mutator : qAsConst(entry.mutators))
+                mutator(entry.payload, entry.iteration);
+            entry.frame.setPayload(entry.payload);
+            m_messages.push_back(dptr->createMessage(entry.frame));
+            m_pending.emplace_back(it.first, std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.due).count());
+
+            // Keep phase of schedule - missed slots are skipped instead of sent in burst
+            ++entry.iteration;
+            entry.due += entry.period;
+            if (entry.due <= now)
+                entry.due += entry.period * ((now - entry.due) / entry.period + 1);
+
+            if (entry.remaining > 0)
+                --entry.remaining;
+        }
+        locker.unlock();
+
+        const int sent = m_messages.empty() ? 0 : dptr->transmit(m_messages);
+        if (sent < int(m_messages.size()))
+            dptr->reportWriteError(int(m_messages.size()) - sent, int(m_messages.size()));
+
+        locker.lock();
+
+        // Transmission stops at first failed frame - statistics count frames actually transmitted.
+        // Entries removed meanwhile are skipped.
+        for (size_t i = 0; i < m_pending.size(); ++i)
+        {
+            const auto it = m_entries.find(m_pending[i].first);
+            if (it == m_entries.end())
+                continue;
+
+            Statistics &stats = it->second.stats;
+            if (int(i) >= sent)
+            {
+                ++stats.failed;
+                continue;
+            }
+            const qint64 jitter = m_pending[i].second;
+            stats.lastJitter = jitter;
+            stats.minJitter  = stats.sent ? std::min(stats.minJitter, jitter) : jitter;
+            stats.maxJitter  = stats.sent ? std::max(stats.maxJitter, jitter) : jitter;
+            ++stats.sent;
+            stats.meanJitter += (double(jitter) - stats.meanJitter) / double(stats.sent);
+        }
+    }
+}
+
+// Mutator is created for payload of given size - bytes it writes or reads have to be within it
+IcsNeoTransmitScheduler::PayloadMutator IcsNeoTransmitScheduler::createMutator(const QVariantMap &spec, int payloadSize,
+                                                                               QString *errorMessage)
+{
+    const QString type = spec.value(QStringLiteral("type")).toString();
+    const int byte = spec.value(QStringLiteral("byte"), -1).toInt();
+
+    if (byte < 0 || byte >= payloadSize)
+    {
+        *errorMessage = IcsNeoCanBackend::tr("Invalid payload byte %1 for %2 mutator of %3 bytes payload")
+                        .arg(byte).arg(type).arg(payloadSize);
+        return PayloadMutator();
+    }
+
+    // Rolling counter: {type: "counter", byte, shift = 0, bits = 8, start = 0, step = 1}
+    if (type == QLatin1String("counter"))
+    {
+        const int shift     = spec.value(QStringLiteral("shift"), 0).toInt();
+        const int bits      = spec.value(QStringLiteral("bits"), 8).toInt();
+        const quint64 start = spec.value(QStringLiteral("start"), 0).toULongLong();
+        const quint64 step  = spec.value(QStringLiteral("step"), 1).toULongLong();
+
+        if (bits < 1 || shift < 0 || shift + bits > 8)
+        {
+            *errorMessage = IcsNeoCanBackend::tr("Invalid counter bits %1 with shift %2").arg(bits).arg(shift);
+            return PayloadMutator();
+        }
+
+        const quint8 mask = quint8(((1u << bits) - 1) << shift);
+        return [=](QByteArray &payload, quint64 iteration) {
+            if (payload.size() <= byte)
+                return;
+            const quint8 value = quint8((start + iteration * step) << shift) & mask;
+            payload[byte] = char((quint8(payload.at(byte)) & ~mask) | value);
+        };
+    }
+
+    // CRC8 over payload bytes from..to except target byte
+    // {type: "crc8", byte, from = 0, to = last, polynomial = 0x1D, init = 0xFF, xorOut = 0xFF} - SAE J1850 by default
+    if (type == QLatin1String("crc8"))
+    {
+        const int from          = spec.value(QStringLiteral("from"), 0).toInt();
+        const int to            = spec.value(QStringLiteral("to"), -1).toInt();
+        const quint8 polynomial = quint8(spec.value(QStringLiteral("polynomial"), 0x1D).toUInt());
+        const quint8 init       = quint8(spec.value(QStringLiteral("init"), 0xFF).toUInt());
+        const quint8 xorOut     = quint8(spec.value(QStringLiteral("xorOut"), 0xFF).toUInt());
+
+        if (from < 0 || from >= payloadSize || to >= payloadSize || (to >= 0 && to < from))
+        {
+            *errorMessage = IcsNeoCanBackend::tr("Invalid crc8 range %1..%2 of %3 bytes payload")
+                            .arg(from).arg(to).arg(payloadSize);
+            return PayloadMutator();
+        }
+
+        return [=](QByteArray &payload, quint64) {
+            if (payload.size() <= byte)
+                return;
+            const int last = to < 0 ? payload.size() - 1 : qMin(to, payload.size() - 1);
+            quint8 crc = init;
+            for (int i = qMax(from, 0); i <= last; ++i)
+            {
+                if (i == byte)
+                    continue;
+                crc ^= quint8(payload.at(i));
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 0x80) ? quint8((crc << 1) ^ polynomial) : quint8(crc << 1);
+            }
+            payload[byte] = char(crc ^ xorOut);
+        };
+    }
+
+    *errorMessage = IcsNeoCanBackend::tr("Unknown payload mutator type '%1'").arg(type);
+    return PayloadMutator();
+}
+
+QT_END_NAMESPACE
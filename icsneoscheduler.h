@@ -0,0 +1,94 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOSCHEDULER_H
+#define ICSNEOSCHEDULER_H
+
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qvector.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class IcsNeoCanBackendPrivate;
+
+namespace icsneo
+{
+  class Message;
+}
+
+/**
+ * Transmits registered frames periodically from own thread. Frames are handed directly
+ * to transmit path of backend - they do not pass through QCanBusDevice outgoing queue.
+ */
+class IcsNeoTransmitScheduler : public QThread
+{
+    // no Q_OBJECT macro!
+public:
+    using Clock = std::chrono::steady_clock;
+    /** Modifies payload before each transmission - iteration starts from 0 */
+    using PayloadMutator = std::function<void(QByteArray &payload, quint64 iteration)>;
+
+    struct Statistics
+    {
+        quint64 sent = 0;
+        quint64 failed = 0;         // transmissions refused by device
+        qint64 lastJitter = 0;      // [ns]
+        qint64 minJitter = 0;       // [ns]
+        qint64 maxJitter = 0;       // [ns]
+        double meanJitter = 0.0;    // [ns]
+    };
+
+    IcsNeoTransmitScheduler(IcsNeoCanBackendPrivate *d, std::chrono::nanoseconds spin);
+    ~IcsNeoTransmitScheduler() override;
+
+    int add(const QCanBusFrame &frame, std::chrono::nanoseconds period, qint64 count,
+            const QVector<PayloadMutator> &mutators);
+    bool remove(int id);
+    bool statistics(int id, Statistics *stats) const;
+    void setSpin(std::chrono::nanoseconds spin);
+    void stop();
+
+    static PayloadMutator createMutator(const QVariantMap &spec, int payloadSize, QString *errorMessage);
+
+protected:
+    void run() override;
+
+private:
+    struct Entry
+    {
+        QCanBusFrame frame;
+        QByteArray payload;
+        std::chrono::nanoseconds period;
+        qint64 remaining;           // < 0 - infinite
+        Clock::time_point due;
+        quint64 iteration = 0;
+        QVector<PayloadMutator> mutators;
+        Statistics stats;
+    };
+
+    IcsNeoCanBackendPrivate * const dptr;
+    mutable std::mutex m_guard;
+    std::condition_variable m_changed;
+    std::map<int, Entry> m_entries;
+    int m_nextId = 1;
+    bool m_stop = false;
+    std::chrono::nanoseconds m_spin;    // final part of waiting for deadline which is spun
+    std::vector<std::shared_ptr<icsneo::Message>> m_messages;
+    std::vector<std::pair<int, qint64>> m_pending;  // id and jitter [ns] of each message being transmitted
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOSCHEDULER_H
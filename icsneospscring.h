@@ -0,0 +1,68 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOSPSCRING_H
+#define ICSNEOSPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * Capacity is rounded up to power of two.
+ */
+template <typename T>
+class IcsNeoSpscRing
+{
+public:
+    explicit IcsNeoSpscRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    // Producer thread only
+    bool push(const T &value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false; // full
+        m_buffer[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T &value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false; // empty
+        value = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Any thread - approximate while producer or consumer is running. Head is loaded first,
+    // so tail read afterwards is never behind it.
+    size_t size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+private:
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_head {0};   // written by consumer
+    alignas(64) std::atomic<size_t> m_tail {0};   // written by producer
+};
+
+#endif // ICSNEOSPSCRING_H
@@ -0,0 +1,62 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneostatistics.h"
+
+QT_BEGIN_NAMESPACE
+
+void IcsNeoChannelStatistics::reset()
+{
+    m_rxFrames.store(0, std::memory_order_relaxed);
+    m_rxBytes.store(0, std::memory_order_relaxed);
+    m_errorFrames.store(0, std::memory_order_relaxed);
+    m_txFrames.store(0, std::memory_order_relaxed);
+    m_txBytes.store(0, std::memory_order_relaxed);
+    m_txErrors.store(0, std::memory_order_relaxed);
+    for (std::atomic<quint64> &bucket : m_latency)
+        bucket.store(0, std::memory_order_relaxed);
+
+    m_snapshotAge.start();
+    m_lastRxFrames = m_lastRxBytes = m_lastTxFrames = m_lastTxBytes = 0;
+}
+
+QVariantMap IcsNeoChannelStatistics::snapshot()
+{
+    const quint64 rxFrames = m_rxFrames.load(std::memory_order_relaxed);
+    const quint64 rxBytes  = m_rxBytes.load(std::memory_order_relaxed);
+    const quint64 txFrames = m_txFrames.load(std::memory_order_relaxed);
+    const quint64 txBytes  = m_txBytes.load(std::memory_order_relaxed);
+
+    QVariantList histogram;
+    for (const std::atomic<quint64> &bucket : m_latency)
+        histogram.append(bucket.load(std::memory_order_relaxed));
+
+    const double seconds = m_snapshotAge.isValid() ? double(m_snapshotAge.nsecsElapsed()) / 1e9 : 0.0;
+    auto rate = [seconds](quint64 value, quint64 last) {
+        return seconds > 0.0 ? double(value - last) / seconds : 0.0;
+    };
+
+    const QVariantMap map {
+        { QStringLiteral("rxFrames"),          rxFrames },
+        { QStringLiteral("rxBytes"),           rxBytes },
+        { QStringLiteral("errorFrames"),       m_errorFrames.load(std::memory_order_relaxed) },
+        { QStringLiteral("txFrames"),          txFrames },
+        { QStringLiteral("txBytes"),           txBytes },
+        { QStringLiteral("txErrors"),          m_txErrors.load(std::memory_order_relaxed) },
+        { QStringLiteral("rxFramesPerSecond"), rate(rxFrames, m_lastRxFrames) },
+        { QStringLiteral("rxBytesPerSecond"),  rate(rxBytes, m_lastRxBytes) },
+        { QStringLiteral("txFramesPerSecond"), rate(txFrames, m_lastTxFrames) },
+        { QStringLiteral("txBytesPerSecond"),  rate(txBytes, m_lastTxBytes) },
+        { QStringLiteral("batchLatency"),      histogram }
+    };
+
+    m_snapshotAge.start();
+    m_lastRxFrames = rxFrames;
+    m_lastRxBytes  = rxBytes;
+    m_lastTxFrames = txFrames;
+    m_lastTxBytes  = txBytes;
+    return map;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,86 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOSTATISTICS_H
+#define ICSNEOSTATISTICS_H
+
+#include <QtCore/qalgorithms.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qvariant.h>
+
+#include <array>
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Runtime counters of single channel. Counters are updated from receive, transmit and Qt
+ * threads by relaxed increments - each counter is exact, but snapshot of all of them is not
+ * taken atomically.
+ */
+class IcsNeoChannelStatistics
+{
+public:
+    // Bucket n counts latencies in [2^(n-1), 2^n) us, bucket 0 latencies below 1 us
+    static constexpr int LatencyBuckets = 24;
+
+    void addReceived(quint64 bytes, bool error)
+    {
+        m_rxFrames.fetch_add(1, std::memory_order_relaxed);
+        m_rxBytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (error)
+            m_errorFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Error frame generated by plugin, not received from bus
+    void addErrorFrame()
+    {
+        m_errorFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void addTransmitted(quint64 frames, quint64 bytes)
+    {
+        m_txFrames.fetch_add(frames, std::memory_order_relaxed);
+        m_txBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void addTransmitErrors(quint64 frames)
+    {
+        m_txErrors.fetch_add(frames, std::memory_order_relaxed);
+    }
+
+    // Age of the oldest frame of receive batch when batch is handed over to QCanBusDevice - one sample
+    // per batch, upper bound of latency of its frames
+    void addBatchLatency(qint64 ns)
+    {
+        const quint64 us = ns > 0 ? quint64(ns) / 1000 : 0;
+        const int bucket = qMin(64 - int(qCountLeadingZeroBits(us)), LatencyBuckets - 1);
+        m_latency[size_t(bucket)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset();
+
+    // Counters with rates since previous snapshot - called from Qt thread only
+    QVariantMap snapshot();
+
+private:
+    std::atomic<quint64> m_rxFrames {0};
+    std::atomic<quint64> m_rxBytes {0};
+    std::atomic<quint64> m_errorFrames {0};
+    std::atomic<quint64> m_txFrames {0};
+    std::atomic<quint64> m_txBytes {0};
+    std::atomic<quint64> m_txErrors {0};
+    std::array<std::atomic<quint64>, LatencyBuckets> m_latency {};
+
+    // Previous snapshot for rates
+    QElapsedTimer m_snapshotAge;
+    quint64 m_lastRxFrames = 0;
+    quint64 m_lastRxBytes = 0;
+    quint64 m_lastTxFrames = 0;
+    quint64 m_lastTxBytes = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOSTATISTICS_H
@@ -0,0 +1,135 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneosupervisor.h"
+#include "icsneocanbackend_p.h"
+
+#include <QtCore/qloggingcategory.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_ICSNEOCAN)
+
+constexpr std::chrono::milliseconds IcsNeoDeviceSupervisor::CheckInterval;
+constexpr std::chrono::milliseconds IcsNeoDeviceSupervisor::InitialBackoff;
+constexpr std::chrono::milliseconds IcsNeoDeviceSupervisor::MaxBackoff;
+
+IcsNeoDeviceSupervisor::IcsNeoDeviceSupervisor(IcsNeoDeviceDispatcher *dispatcher,
+                                               const std::shared_ptr<icsneo::Device> &device) :
+    m_dispatcher(dispatcher),
+    m_device(device)
+{
+    // Errors of device wake supervisor at once instead of next periodic check
+    icsneo::Device *raw = m_device.get();
+    m_eventCallbackId = icsneo::AddEventCallback(icsneo::EventCallback([this, raw](std::shared_ptr<icsneo::APIEvent> event)
+    {
+        if (!event || event->getDevice() != raw || event->getSeverity() != icsneo::APIEvent::Severity::Error)
+            return;
+        {
+            std::lock_guard<std::mutex> locker(m_guard);
+            m_suspect = true;
+        }
+        m_changed.notify_one();
+    }));
+}
+
+IcsNeoDeviceSupervisor::~IcsNeoDeviceSupervisor()
+{
+    stop();
+    if (m_eventCallbackId >= 0)
+        icsneo::RemoveEventCallback(m_eventCallbackId);
+}
+
+void IcsNeoDeviceSupervisor::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        m_stop = true;
+    }
+    m_changed.notify_one();
+    wait();
+}
+
+void IcsNeoDeviceSupervisor::run()
+{
+    std::chrono::milliseconds backoff = InitialBackoff;
+    bool outage = false;
+    Clock::time_point outageStart;
+
+    std::unique_lock<std::mutex> locker(m_guard);
+    while (!m_stop)
+    {
+        m_changed.wait_for(locker, CheckInterval, [this]() { return m_stop || m_suspect; });
+        if (m_stop)
+            break;
+        const bool suspect = m_suspect;
+        m_suspect = false;
+        locker.unlock();
+
+        const Fault fault = diagnose(suspect);
+        if (fault == NoFault)
+        {
+            locker.lock();
+            continue;
+        }
+
+        if (!outage)
+        {
+            outage = true;
+            outageStart = Clock::now();
+            qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "%s of %s detected - recovering",
+                      fault == BusOff ? "Bus off" : "Loss", m_device->describe().c_str());
+        }
+
+        const bool recovered = recover(fault);
+        locker.lock();
+
+        if (recovered)
+        {
+            m_dispatcher->recovered();
+            outage = false;
+            backoff = InitialBackoff;
+            m_recoveries.fetch_add(1, std::memory_order_relaxed);
+            m_downtime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - outageStart).count(),
+                                 std::memory_order_relaxed);
+            qCWarning(QT_CANBUS_PLUGINS_ICSNEOCAN, "%s recovered", m_device->describe().c_str());
+            continue;
+        }
+
+        m_changed.wait_for(locker, backoff, [this]() { return m_stop; });
+        backoff = std::min(backoff * 2, MaxBackoff);
+    }
+}
+
+// Session guard of device keeps application from opening, closing or resetting it meanwhile
+IcsNeoDeviceSupervisor::Fault IcsNeoDeviceSupervisor::diagnose(bool suspect)
+{
+    QMutexLocker session(IcsNeoCanBackendPrivate::sessionGuard(m_device.get()));
+
+    if (!m_device->isOpen() || !m_device->isOnline())
+        return DeviceLost;
+
+    // Error event alone does not mean device is gone - settings read is round trip to device
+    if (suspect && !m_device->settings->refresh())
+        return DeviceLost;
+
+    return m_dispatcher->anyBusOff() ? BusOff : NoFault;
+}
+
+bool IcsNeoDeviceSupervisor::recover(Fault fault)
+{
+    QMutexLocker session(IcsNeoCanBackendPrivate::sessionGuard(m_device.get()));
+
+    if (fault == BusOff)
+    {
+        // Controller leaves bus off when network goes offline - settings stay untouched
+        return m_device->goOffline() && m_device->goOnline();
+    }
+
+    // Device may have been power cycled - configuration of opened channels is applied again
+    return m_dispatcher->reopen(true);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,72 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOSUPERVISOR_H
+#define ICSNEOSUPERVISOR_H
+
+#include <QtCore/qthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+QT_BEGIN_NAMESPACE
+
+class IcsNeoDeviceDispatcher;
+
+namespace icsneo
+{
+  class Device;
+}
+
+/**
+ * Watches online state of device and its channels from own thread and recovers them without
+ * involving application - bus off by restarting device, lost device by opening it again with
+ * settings of opened channels. Failed recovery is retried with exponential backoff.
+ */
+class IcsNeoDeviceSupervisor : public QThread
+{
+    // no Q_OBJECT macro!
+public:
+    using Clock = std::chrono::steady_clock;
+
+    IcsNeoDeviceSupervisor(IcsNeoDeviceDispatcher *dispatcher, const std::shared_ptr<icsneo::Device> &device);
+    ~IcsNeoDeviceSupervisor() override;
+
+    void stop();
+
+    quint64 recoveries() const { return m_recoveries.load(std::memory_order_relaxed); }
+    qint64 downtime() const { return m_downtime.load(std::memory_order_relaxed); }   // [ns]
+
+protected:
+    void run() override;
+
+private:
+    enum Fault { NoFault, BusOff, DeviceLost };
+
+    Fault diagnose(bool suspect);
+    bool recover(Fault fault);
+
+    static constexpr std::chrono::milliseconds CheckInterval {250};
+    static constexpr std::chrono::milliseconds InitialBackoff {100};
+    static constexpr std::chrono::milliseconds MaxBackoff {10000};
+
+    IcsNeoDeviceDispatcher * const m_dispatcher;
+    const std::shared_ptr<icsneo::Device> m_device;
+    int m_eventCallbackId = -1;
+
+    std::mutex m_guard;
+    std::condition_variable m_changed;
+    bool m_stop = false;
+    bool m_suspect = false;     // error event of device - liveness is probed
+
+    std::atomic<quint64> m_recoveries {0};
+    std::atomic<qint64> m_downtime {0};
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOSUPERVISOR_H
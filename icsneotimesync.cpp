@@ -0,0 +1,103 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneotimesync.h"
+
+#include <chrono>
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+qint64 IcsNeoClockCorrelator::hostNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void IcsNeoClockCorrelator::addSample(quint64 deviceNs, qint64 hostNs)
+{
+    const qint64 offset = hostNs - qint64(deviceNs);
+
+    if (!m_valid)
+    {
+        m_valid = true;
+        m_origin = deviceNs;
+        m_baseOffset = offset;
+        m_windowStart = deviceNs;
+        m_windowOffset = offset;
+        m_windowDevice = deviceNs;
+        m_intercept = 0.0;
+        return;
+    }
+
+    // Messages are not strictly ordered by device time - small step back is just ignored
+    if (deviceNs < m_windowStart && m_windowStart - deviceNs <= quint64(WindowNs))
+        return;
+
+    // Device clock went back - device was restarted
+    if (deviceNs < m_windowStart)
+    {
+        m_valid = false;
+        m_count = 0;
+        m_next = 0;
+        m_slope = 0.0;
+        addSample(deviceNs, hostNs);
+        return;
+    }
+
+    if (deviceNs - m_windowStart < quint64(WindowNs))
+    {
+        if (offset < m_windowOffset)
+        {
+            m_windowOffset = offset;
+            m_windowDevice = deviceNs;
+            if (m_count == 0) // no fit yet - follow current window
+                m_intercept = double(offset - m_baseOffset);
+        }
+        return;
+    }
+
+    m_points[size_t(m_next)] = { double(qint64(m_windowDevice - m_origin)), double(m_windowOffset - m_baseOffset) };
+    m_next = (m_next + 1) % MaxPoints;
+    if (m_count < MaxPoints)
+        ++m_count;
+    fit();
+
+    m_windowStart = deviceNs;
+    m_windowOffset = offset;
+    m_windowDevice = deviceNs;
+}
+
+void IcsNeoClockCorrelator::fit()
+{
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (int i = 0; i < m_count; ++i)
+    {
+        meanX += m_points[size_t(i)].x;
+        meanY += m_points[size_t(i)].y;
+    }
+    meanX /= m_count;
+    meanY /= m_count;
+
+    double sxy = 0.0;
+    double sxx = 0.0;
+    for (int i = 0; i < m_count; ++i)
+    {
+        const double dx = m_points[size_t(i)].x - meanX;
+        sxy += dx * (m_points[size_t(i)].y - meanY);
+        sxx += dx * dx;
+    }
+
+    m_slope = sxx > 0.0 ? sxy / sxx : 0.0;
+    m_intercept = meanY - m_slope * meanX;
+}
+
+qint64 IcsNeoClockCorrelator::toHost(quint64 deviceNs) const
+{
+    const double x = double(qint64(deviceNs - m_origin));
+    return qint64(deviceNs) + m_baseOffset + std::llround(m_intercept + m_slope * x);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,61 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOTIMESYNC_H
+#define ICSNEOTIMESYNC_H
+
+#include <QtCore/qglobal.h>
+
+#include <array>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Estimates offset and drift of device clock against host monotonic clock.
+ * Host receive time is always later than device timestamp by unknown latency, so only the
+ * smallest host-device difference within each window is used - line is fitted through these
+ * lower envelope points by least squares.
+ */
+class IcsNeoClockCorrelator
+{
+public:
+    static qint64 hostNow();    // CLOCK_MONOTONIC [ns]
+
+    void addSample(quint64 deviceNs, qint64 hostNs);
+    qint64 toHost(quint64 deviceNs) const;
+
+    bool isValid() const { return m_valid; }
+    double drift() const { return m_slope; }    // [ns/ns]
+
+private:
+    static constexpr qint64 WindowNs = 1000000000;  // one lower envelope point per second
+    static constexpr int MaxPoints = 16;
+
+    struct Point
+    {
+        double x;   // device time since m_origin [ns]
+        double y;   // host-device difference relative to m_baseOffset [ns]
+    };
+
+    void fit();
+
+    bool m_valid = false;
+    quint64 m_origin = 0;
+    qint64 m_baseOffset = 0;
+
+    quint64 m_windowStart = 0;
+    qint64 m_windowOffset = 0;
+    quint64 m_windowDevice = 0;
+
+    std::array<Point, MaxPoints> m_points;
+    int m_count = 0;
+    int m_next = 0;
+
+    double m_intercept = 0.0;
+    double m_slope = 0.0;
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOTIMESYNC_H
@@ -0,0 +1,101 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneotransmitworker.h"
+#include "icsneocanbackend_p.h"
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+IcsNeoTransmitWorker::Channel::Channel(IcsNeoCanBackendPrivate *d, size_t capacity, int burst) :
+    dptr(d),
+    ring(capacity),
+    burst(burst)
+{
+    messages.reserve(size_t(burst));
+}
+
+IcsNeoTransmitWorker::~IcsNeoTransmitWorker()
+{
+    stop();
+}
+
+// Called when channel is opened - from owner thread of its QCanBusDevice
+IcsNeoTransmitWorker::Channel *IcsNeoTransmitWorker::attach(IcsNeoCanBackendPrivate *d, size_t capacity, int burst)
+{
+    QMutexLocker locker(&m_channelsGuard);
+    m_channels.emplace_back(new Channel(d, capacity, burst));
+    return m_channels.back().get();
+}
+
+// Waits for burst being transmitted - channel is not used by thread once this returns
+void IcsNeoTransmitWorker::detach(Channel *channel)
+{
+    QMutexLocker locker(&m_channelsGuard);
+    m_channels.erase(std::remove_if(m_channels.begin(), m_channels.end(),
+                                    [channel](const std::unique_ptr<Channel> &c) { return c.get() == channel; }),
+                     m_channels.end());
+}
+
+// Called from owner thread of QCanBusDevice of channel
+bool IcsNeoTransmitWorker::enqueue(Channel *channel, const QCanBusFrame &frame)
+{
+    if (!channel->ring.push(frame))
+        return false;
+    m_wake.release();
+    return true;
+}
+
+void IcsNeoTransmitWorker::stop()
+{
+    m_stop.store(true, std::memory_order_release);
+    m_wake.release();
+    wait();
+}
+
+void IcsNeoTransmitWorker::run()
+{
+    while (true)
+    {
+        // Consume all pending wake-ups at once - rings are drained below anyway
+        m_wake.acquire(qMax(1, m_wake.available()));
+        if (m_stop.load(std::memory_order_acquire))
+            break;
+
+        // Guard is released between rounds, so closing channel does not wait for busy ones
+        bool pending = true;
+        while (pending && !m_stop.load(std::memory_order_acquire))
+        {
+            pending = false;
+            QMutexLocker locker(&m_channelsGuard);
+            for (const std::unique_ptr<Channel> &channel : m_channels)
+                pending |= transmitBurst(channel.get());
+        }
+    }
+}
+
+// Returns true when ring may hold more frames
+bool IcsNeoTransmitWorker::transmitBurst(Channel *channel)
+{
+    QCanBusFrame frame;
+    bool pending = true;
+    channel->messages.clear();
+    while (int(channel->messages.size()) < channel->burst && (pending = channel->ring.pop(frame)))
+        channel->messages.push_back(channel->dptr->createMessage(frame));
+
+    if (channel->messages.empty())
+        return false;
+
+    IcsNeoCanBackendPrivate *dptr = channel->dptr;
+    const int size = int(channel->messages.size());
+    const int sent = dptr->transmit(channel->messages);
+    if (sent > 0)
+        dptr->reportFramesWritten(qint64(sent));
+    if (sent < size)
+        dptr->reportWriteError(size - sent, size);
+    return pending;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,71 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOTRANSMITWORKER_H
+#define ICSNEOTRANSMITWORKER_H
+
+#include "icsneospscring.h"
+
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qthread.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class IcsNeoCanBackendPrivate;
+
+namespace icsneo
+{
+  class Message;
+}
+
+/**
+ * Transmits frames outside of Qt event loop. One thread serves all channels of device - each
+ * channel pushes frames by writeFrame() into its own lock-free ring, so every ring keeps single
+ * producer, and channels take turns transmitting bursts.
+ */
+class IcsNeoTransmitWorker : public QThread
+{
+    // no Q_OBJECT macro!
+public:
+    struct Channel
+    {
+        Channel(IcsNeoCanBackendPrivate *d, size_t capacity, int burst);
+
+        IcsNeoCanBackendPrivate * const dptr;
+        IcsNeoSpscRing<QCanBusFrame> ring;
+        const int burst;
+        std::vector<std::shared_ptr<icsneo::Message>> messages;
+    };
+
+    IcsNeoTransmitWorker() = default;
+    ~IcsNeoTransmitWorker() override;
+
+    Channel *attach(IcsNeoCanBackendPrivate *d, size_t capacity, int burst);
+    void detach(Channel *channel); // frames not transmitted yet are dropped
+
+    bool enqueue(Channel *channel, const QCanBusFrame &frame);
+    static int queued(const Channel *channel) { return int(channel->ring.size()); }
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    static bool transmitBurst(Channel *channel);
+
+    QMutex m_channelsGuard; // held by thread while transmitting, so detached channel is not in use
+    std::vector<std::unique_ptr<Channel>> m_channels;
+    QSemaphore m_wake;
+    std::atomic<bool> m_stop {false};
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOTRANSMITWORKER_H
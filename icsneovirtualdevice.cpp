@@ -0,0 +1,336 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#include "icsneovirtualdevice.h"
+#include "icsneocanbackend.h"
+#include "icsneotimesync.h"
+
+#include <QtCore/qendian.h>
+
+#include <algorithm>
+#include <thread>
+
+QT_BEGIN_NAMESPACE
+
+// pcapng block types
+static const quint32 SectionHeaderBlock        = 0x0A0D0D0A;
+static const quint32 InterfaceDescriptionBlock = 0x00000001;
+static const quint32 EnhancedPacketBlock       = 0x00000006;
+static const quint32 ByteOrderMagic            = 0x1A2B3C4D;
+static const quint16 LinkTypeCanSocketCan      = 227;
+static const quint16 OptionTimestampResolution = 9;
+
+/*-----------------------------------------------------------------------------------------
+                                 R E P L A Y   D E V I C E
+-----------------------------------------------------------------------------------------*/
+IcsNeoReplayDevice::IcsNeoReplayDevice(const QString &fileName, quint32 interfaceId, double speed,
+                                       const icsneo::Network &network) :
+    m_file(fileName),
+    m_interfaceId(interfaceId),
+    m_speed(speed)
+{
+    m_message.network = network;
+    m_message.data.reserve(64);
+}
+
+IcsNeoReplayDevice::~IcsNeoReplayDevice()
+{
+    close();
+}
+
+bool IcsNeoReplayDevice::open(const MessageSink &sink, QString *errorMessage)
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        *errorMessage = m_file.errorString();
+        return false;
+    }
+
+    // Only pcapng files in host byte order are supported
+    quint32 header[3];
+    if (m_file.read(reinterpret_cast<char *>(header), sizeof(header)) != qint64(sizeof(header)) ||
+        header[0] != SectionHeaderBlock || header[2] != ByteOrderMagic)
+    {
+        *errorMessage = IcsNeoCanBackend::tr("%1 is not pcapng file in host byte order").arg(m_file.fileName());
+        m_file.close();
+        return false;
+    }
+    m_file.seek(0);
+
+    m_sink = sink;
+    m_stop.store(false, std::memory_order_release);
+    start();
+    return true;
+}
+
+void IcsNeoReplayDevice::close()
+{
+    m_stop.store(true, std::memory_order_release);
+    wait();
+    m_file.close();
+}
+
+bool IcsNeoReplayDevice::transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages)
+{
+    Q_UNUSED(messages);
+    return true;
+}
+
+void IcsNeoReplayDevice::run()
+{
+    using Clock = std::chrono::steady_clock;
+    // Long gaps in recording are waited in slices, so close() is not delayed
+    static constexpr std::chrono::milliseconds waitSlice(100);
+
+    QByteArray block;
+    bool started = false;
+    quint64 firstTimestamp = 0;
+    Clock::time_point start;
+
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+        quint32 header[2];
+        if (m_file.read(reinterpret_cast<char *>(header), sizeof(header)) != qint64(sizeof(header)))
+            break; // end of file
+
+        const quint32 type = header[0];
+        const quint32 length = header[1];
+        if (length < 12 || length % 4)
+            break; // corrupted file
+
+        block.resize(int(length - 8));
+        if (m_file.read(block.data(), block.size()) != block.size())
+            break;
+
+        if (type == SectionHeaderBlock)
+        {
+            m_interfaces.clear(); // interface ids are numbered per section
+            continue;
+        }
+        if (type == InterfaceDescriptionBlock)
+        {
+            readInterface(block);
+            continue;
+        }
+
+        quint64 timestamp = 0;
+        if (type != EnhancedPacketBlock || !readPacket(block, &timestamp))
+            continue;
+
+        if (m_speed > 0.0)
+        {
+            if (!started)
+            {
+                started = true;
+                firstTimestamp = timestamp;
+                start = Clock::now();
+            }
+            const qint64 offset = qint64(double(qint64(timestamp - firstTimestamp)) / m_speed);
+            const Clock::time_point due = start + std::chrono::nanoseconds(offset);
+            while (!m_stop.load(std::memory_order_acquire) && Clock::now() < due)
+                std::this_thread::sleep_until(std::min(due, Clock::now() + waitSlice));
+        }
+
+        m_message.timestamp = timestamp;
+        m_sink(m_message);
+    }
+}
+
+void IcsNeoReplayDevice::readInterface(const QByteArray &block)
+{
+    Interface interface;
+    const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+    const int end = block.size() - 4; // trailing block length
+
+    if (end >= 8)
+        interface.linkType = qFromUnaligned<quint16>(data);
+
+    for (int offset = 8; offset + 4 <= end; )
+    {
+        const quint16 code = qFromUnaligned<quint16>(data + offset);
+        const quint16 size = qFromUnaligned<quint16>(data + offset + 2);
+        if (code == 0 || offset + 4 + size > end)
+            break;
+
+        if (code == OptionTimestampResolution && size >= 1)
+        {
+            const quint8 resolution = data[offset + 4];
+            quint64 units = 1;
+            for (int i = 0; i < (resolution & 0x7F); i++)
+                units *= (resolution & 0x80) ? 2 : 10;
+            interface.unitsPerSecond = units;
+        }
+        offset += 4 + ((size + 3) & ~3);
+    }
+    m_interfaces.push_back(interface);
+}
+
+bool IcsNeoReplayDevice::readPacket(const QByteArray &block, quint64 *timestampNs)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+    if (block.size() < 20 + 8 + 4)
+        return false;
+
+    const quint32 interfaceId = qFromUnaligned<quint32>(data);
+    if (interfaceId != m_interfaceId || interfaceId >= m_interfaces.size() ||
+        m_interfaces[interfaceId].linkType != LinkTypeCanSocketCan)
+        return false;
+
+    const quint64 units = m_interfaces[interfaceId].unitsPerSecond;
+    const quint64 raw = (quint64(qFromUnaligned<quint32>(data + 4)) << 32) | qFromUnaligned<quint32>(data + 8);
+    *timestampNs = (raw / units) * 1000000000ULL + quint64(double(raw % units) * (1e9 / double(units)));
+
+    const quint32 captured = qMin(qFromUnaligned<quint32>(data + 12), quint32(block.size() - 20 - 4));
+    if (captured < 8)
+        return false;
+
+    // struct can_frame / canfd_frame
+    const uchar *packet = data + 20;
+    const quint32 canId = qFromBigEndian<quint32>(packet);
+    const quint8 flags = packet[5];
+    const int length = qMin<int>(qMin<int>(packet[4], 64), int(captured) - 8);
+
+    m_message.isExtended          = canId & 0x80000000U;
+    m_message.isRemote            = canId & 0x40000000U;
+    m_message.error               = canId & 0x20000000U;
+    m_message.arbid               = canId & (m_message.isExtended ? 0x1FFFFFFFU : 0x7FFU);
+    m_message.isCANFD             = (flags & 0x04) || captured > 16;
+    m_message.baudrateSwitch      = flags & 0x01;
+    m_message.errorStateIndicator = flags & 0x02;
+    m_message.data.assign(packet + 8, packet + 8 + length);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------
+                               L O O P B A C K   D E V I C E
+-----------------------------------------------------------------------------------------*/
+IcsNeoLoopbackDevice::IcsNeoLoopbackDevice(int bitRate, int dataBitRate) :
+    m_bitRate(bitRate),
+    m_dataBitRate(dataBitRate)
+{
+}
+
+IcsNeoLoopbackDevice::~IcsNeoLoopbackDevice()
+{
+    close();
+}
+
+bool IcsNeoLoopbackDevice::open(const MessageSink &sink, QString *errorMessage)
+{
+    Q_UNUSED(errorMessage);
+    m_sink = sink;
+    m_stop = false;
+    m_busFree = Clock::now();
+    start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void IcsNeoLoopbackDevice::close()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        m_stop = true;
+        m_pending.clear(); // frames still on emulated bus are lost as on real device
+    }
+    m_changed.notify_one();
+    wait();
+}
+
+bool IcsNeoLoopbackDevice::transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_guard);
+        if (m_stop)
+            return false;
+
+        m_busFree = std::max(m_busFree, Clock::now());
+        for (const std::shared_ptr<icsneo::Message> &message : messages)
+        {
+            std::shared_ptr<icsneo::CANMessage> frame = std::static_pointer_cast<icsneo::CANMessage>(message);
+            m_busFree += std::chrono::nanoseconds(frameDuration(*frame, m_bitRate, m_dataBitRate));
+            m_pending.push_back({ m_busFree, std::move(frame) });
+        }
+    }
+    m_changed.notify_one();
+    return true;
+}
+
+qint64 IcsNeoLoopbackDevice::frameDuration(const icsneo::CANMessage &message, int bitRate, int dataBitRate)
+{
+    if (bitRate <= 0)
+        return 0;
+
+    const int bytes = message.isRemote ? 0 : int(message.data.size());
+    int nominalBits = 0;
+    int dataBits = 0;
+
+    if (!message.isCANFD)
+    {
+        // SOF up to CRC is stuffed, followed by CRC delimiter, ACK, EOF and interframe space
+        const int stuffed = (message.isExtended ? 54 : 34) + 8 * bytes;
+        nominalBits = stuffed + (stuffed - 1) / 4 + 13;
+    }
+    else
+    {
+        // SOF up to BRS at nominal rate, ESI up to CRC delimiter at data rate when BRS is set
+        const int arbitration = message.isExtended ? 36 : 17;
+        const int dynamic = 5 + 8 * bytes;                  // ESI, DLC, data
+        const int fixed = 4 + (bytes > 16 ? 21 : 17);       // stuff count, CRC - fixed stuff bit every 4 bits
+        nominalBits = arbitration + (arbitration - 1) / 4 + 12;
+        dataBits = dynamic + dynamic / 4 + fixed + fixed / 4 + 2;
+        if (!message.baudrateSwitch || dataBitRate <= 0)
+        {
+            nominalBits += dataBits;
+            dataBits = 0;
+        }
+    }
+
+    qint64 duration = qint64(nominalBits) * 1000000000 / bitRate;
+    if (dataBits)
+        duration += qint64(dataBits) * 1000000000 / dataBitRate;
+    return duration;
+}
+
+void IcsNeoLoopbackDevice::run()
+{
+    // Condition variable wake-up is too coarse for bus timing - last part of waiting is done by yielding
+    static constexpr std::chrono::microseconds spinMargin(200);
+
+    std::unique_lock<std::mutex> locker(m_guard);
+    while (!m_stop)
+    {
+        if (m_pending.empty())
+        {
+            m_changed.wait(locker);
+            continue;
+        }
+
+        const Clock::time_point due = m_pending.front().due;
+        if (due - Clock::now() > spinMargin)
+        {
+            m_changed.wait_until(locker, due - spinMargin);
+            continue;
+        }
+
+        if (Clock::now() < due)
+        {
+            locker.unlock();
+            while (Clock::now() < due)
+                std::this_thread::yield();
+            locker.lock();
+            continue;
+        }
+
+        std::shared_ptr<icsneo::CANMessage> message = std::move(m_pending.front().message);
+        m_pending.pop_front();
+        locker.unlock();
+
+        message->timestamp = quint64(IcsNeoClockCorrelator::hostNow());
+        m_sink(*message);
+
+        locker.lock();
+    }
+}
+
+QT_END_NAMESPACE
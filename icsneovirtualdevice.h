@@ -0,0 +1,124 @@
+/****************************************************************************
+** Copyright (C) 2021  Tomasz Ziobrowski <t.ziobrowski@3electrons.com>
+****************************************************************************/
+
+#ifndef ICSNEOVIRTUALDEVICE_H
+#define ICSNEOVIRTUALDEVICE_H
+
+#include "icsneo/icsneocpp.h"
+
+#include <QtCore/qfile.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+/**
+ * Stand-in for icsneo::Device used by interfaces without hardware. Received messages
+ * are passed to the sink, which is the same receive path as libicsneo callback uses.
+ */
+class IcsNeoVirtualDevice
+{
+public:
+    using MessageSink = std::function<void(const icsneo::CANMessage &)>;
+
+    virtual ~IcsNeoVirtualDevice() = default;
+
+    virtual bool open(const MessageSink &sink, QString *errorMessage) = 0;
+    virtual void close() = 0;
+    virtual bool transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages) = 0;
+};
+
+/**
+ * Replays frames recorded in pcapng file (LINKTYPE_CAN_SOCKETCAN) with original timing
+ * scaled by speed - speed 0 replays as fast as possible. Transmitted frames are discarded.
+ * Frames of single pcapng interface are replayed - IcsNeoCaptureWriter records each network
+ * of captured interface as own pcapng interface, in order of its channels.
+ */
+class IcsNeoReplayDevice : public QThread, public IcsNeoVirtualDevice
+{
+    // no Q_OBJECT macro!
+public:
+    IcsNeoReplayDevice(const QString &fileName, quint32 interfaceId, double speed, const icsneo::Network &network);
+    ~IcsNeoReplayDevice() override;
+
+    bool open(const MessageSink &sink, QString *errorMessage) override;
+    void close() override;
+    bool transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages) override;
+
+protected:
+    void run() override;
+
+private:
+    struct Interface
+    {
+        quint16 linkType = 0;
+        quint64 unitsPerSecond = 1000000;    // pcapng default resolution is microseconds
+    };
+
+    void readInterface(const QByteArray &block);
+    bool readPacket(const QByteArray &block, quint64 *timestampNs);
+
+    QFile m_file;
+    const quint32 m_interfaceId;
+    const double m_speed;
+    MessageSink m_sink;
+    std::atomic<bool> m_stop {false};
+    std::vector<Interface> m_interfaces;
+    icsneo::CANMessage m_message;   // reused for every replayed frame
+};
+
+/**
+ * Echoes transmitted frames back to the sink after the time they would occupy the bus at
+ * configured bit rates. Frames are serialized one after another as on real bus, so queued
+ * frames wait for preceding ones. Bit rate 0 echoes frames without delay.
+ */
+class IcsNeoLoopbackDevice : public QThread, public IcsNeoVirtualDevice
+{
+    // no Q_OBJECT macro!
+public:
+    IcsNeoLoopbackDevice(int bitRate, int dataBitRate);
+    ~IcsNeoLoopbackDevice() override;
+
+    bool open(const MessageSink &sink, QString *errorMessage) override;
+    void close() override;
+    bool transmit(const std::vector<std::shared_ptr<icsneo::Message>> &messages) override;
+
+    // Bus time of frame with worst case bit stuffing and interframe space [ns]
+    static qint64 frameDuration(const icsneo::CANMessage &message, int bitRate, int dataBitRate);
+
+protected:
+    void run() override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        Clock::time_point due;
+        std::shared_ptr<icsneo::CANMessage> message;
+    };
+
+    const int m_bitRate;
+    const int m_dataBitRate;
+    MessageSink m_sink;
+
+    std::mutex m_guard;
+    std::condition_variable m_changed;
+    std::deque<Pending> m_pending;
+    Clock::time_point m_busFree;    // end of last frame on emulated bus
+    bool m_stop = true;
+};
+
+QT_END_NAMESPACE
+
+#endif // ICSNEOVIRTUALDEVICE_H
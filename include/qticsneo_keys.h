@@ -6,4 +6,45 @@
 /** Flash settings into EEPROM memory of device  */
 #define ParameterFlashKey (QCanBusDevice::UserKey+3)
 
+/** Maximum number of received frames collected before they are handed over to QCanBusDevice (1 = no batching) */
+#define ParameterReceiveBatchSizeKey (QCanBusDevice::UserKey+4)
+/** Maximum time in milliseconds a received frame may wait in the batch before it is handed over (0 = no batching) */
+#define ParameterReceiveLatencyKey (QCanBusDevice::UserKey+5)
+/** Maximum number of queued frames handed over to libicsneo at single write notification */
+#define ParameterTransmitBurstKey (QCanBusDevice::UserKey+6)
+/** Capacity in frames of lock-free queue feeding transmit thread shared by channels of device (0 = transmit from Qt event loop) */
+#define ParameterTransmitThreadKey (QCanBusDevice::UserKey+7)
+/** Interval in milliseconds of polling received messages from device instead of per message callback (0 = callback) */
+#define ParameterPollingIntervalKey (QCanBusDevice::UserKey+8)
+/** Maximum number of received frames waiting to be read by application (0 = unlimited) */
+#define ParameterReceiveBufferSizeKey (QCanBusDevice::UserKey+9)
+/** What to do when receive buffer is full - one of ReceiveOverflow* values below */
+#define ParameterReceiveOverflowPolicyKey (QCanBusDevice::UserKey+10)
 
+#define ReceiveOverflowDropOldest 0     // frames QCanBusDevice has no room for wait in plugin ring, which discards its oldest ones
+#define ReceiveOverflowDropNewest 1     // received frame is discarded
+#define ReceiveOverflowBlock      2     // libicsneo callback waits till application reads frames - stalls all channels of device (callback mode only)
+/** Timebase of received frame timestamps - one of Timestamp* values below */
+#define ParameterTimestampModeKey (QCanBusDevice::UserKey+11)
+
+#define TimestampDevice 0   // device clock
+#define TimestampHost   1   // device clock mapped onto host monotonic clock (offset and drift compensated)
+/** Path of pcapng file (SocketCAN link type) into which received frames are recorded (empty = no capture) */
+#define ParameterCaptureFileKey (QCanBusDevice::UserKey+12)
+/** Path of pcapng file replayed by virtual interface replayN.M, where M is pcapng interface id (index of IDB in section).
+    Capture of aggregate interface has interface per channel in order of its channels, capture of single channel has interface 0 */
+#define ParameterReplayFileKey (QCanBusDevice::UserKey+13)
+/** Replay speed as multiple of recorded timing (1.0 = original timing, 0 = as fast as possible) */
+#define ParameterReplaySpeedKey (QCanBusDevice::UserKey+14)
+/** What resetController() does - one of Reset* values below */
+#define ParameterResetModeKey (QCanBusDevice::UserKey+15)
+
+#define ResetController 0   // device goes offline and online again, settings are kept - all opened channels of device
+#define ResetSession    1   // device is closed and opened again, settings are kept - all opened channels of device
+#define ResetFactory    2   // default settings are written into device EEPROM
+/** Recover bus off and lost device automatically from background thread (default false) */
+#define ParameterAutoRecoveryKey (QCanBusDevice::UserKey+16)
+/** Reorder window in milliseconds of merged interface merge:A;B;... - frames wait till older frames of other sources cannot arrive anymore */
+#define ParameterMergeWindowKey (QCanBusDevice::UserKey+17)
+/** Final part in microseconds of waiting for deadline of periodic frame which scheduler thread spins instead of sleeping (default 20, 0 = sleeps only) */
+#define ParameterSchedulerSpinKey (QCanBusDevice::UserKey+18)
@@ -0,0 +1,12 @@
+# Plugin and optionally its benchmark - qmake -r CONFIG+=bench in repository root builds both
+
+TEMPLATE = subdirs
+
+SUBDIRS = plugin
+
+plugin.file = icsneo.pro
+
+bench {
+    SUBDIRS += bench
+    bench.file = bench/bench.pro
+}